@@ -0,0 +1,115 @@
+#include "bandwidth_shaper.hpp"
+#include <algorithm>
+#include <ctime>
+
+namespace VideoStreamer
+{
+    namespace
+    {
+        // 每次取令牌的块大小上限：块越小，Live请求插队越及时
+        const size_t kMaxChunkBytes = 64 * 1024;
+
+        // 单次等待的上限，保证时段切换和新的Live请求能及时生效
+        const std::chrono::milliseconds kMaxWait(100);
+
+        // 本地时间的当天第几分钟
+        int minuteOfDay()
+        {
+            std::time_t now = std::time(nullptr);
+            std::tm local;
+            localtime_r(&now, &local);
+            return local.tm_hour * 60 + local.tm_min;
+        }
+
+        bool inProfile(const UploadRateProfile &profile, int minute)
+        {
+            if (profile.startMinute <= profile.endMinute)
+                return minute >= profile.startMinute && minute < profile.endMinute;
+            return minute >= profile.startMinute || minute < profile.endMinute; // 跨午夜
+        }
+    } // namespace
+
+    BandwidthShaper::BandwidthShaper(const AppConfig &cfg) : config(cfg)
+    {
+        limited = config.uploadRateBytesPerSec > 0;
+        for (const auto &profile : config.uploadRateProfiles)
+        {
+            if (profile.bytesPerSecond > 0)
+                limited = true;
+        }
+        chunk = std::max<size_t>(std::min(config.uploadBurstBytes, kMaxChunkBytes), 1024);
+        tokens = static_cast<double>(std::max(config.uploadBurstBytes, chunk));
+        lastRefill = std::chrono::steady_clock::now();
+        waited[0] = 0;
+        waited[1] = 0;
+    }
+
+    uint64_t BandwidthShaper::currentRate() const
+    {
+        if (!limited)
+            return 0;
+        if (!config.uploadRateProfiles.empty())
+        {
+            const int minute = minuteOfDay();
+            for (const auto &profile : config.uploadRateProfiles)
+            {
+                if (inProfile(profile, minute))
+                    return profile.bytesPerSecond;
+            }
+        }
+        return config.uploadRateBytesPerSec;
+    }
+
+    void BandwidthShaper::refill(std::chrono::steady_clock::time_point now, uint64_t rate)
+    {
+        const double capacity = static_cast<double>(std::max(config.uploadBurstBytes, chunk));
+        if (rate == 0)
+            tokens = capacity; // 不限速的时段结束后以满桶开始
+        else
+            tokens = std::min(capacity, tokens + std::chrono::duration<double>(now - lastRefill).count() * rate);
+        lastRefill = now;
+    }
+
+    void BandwidthShaper::acquire(size_t bytes, UploadLane lane)
+    {
+        if (!limited)
+            return;
+
+        const auto begin = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mutex);
+        if (lane == UploadLane::Live)
+            ++liveWaiting;
+
+        // 超过桶容量的请求在桶满时放行并透支，之后的请求等待透支还清
+        const double need = static_cast<double>(std::min(bytes, std::max(config.uploadBurstBytes, chunk)));
+        while (true)
+        {
+            const uint64_t rate = currentRate();
+            refill(std::chrono::steady_clock::now(), rate);
+            const bool mayTake = lane == UploadLane::Live || liveWaiting == 0;
+            if (rate == 0 || (mayTake && tokens >= need))
+            {
+                if (rate != 0)
+                    tokens -= static_cast<double>(bytes);
+                break;
+            }
+
+            auto wait = kMaxWait;
+            if (mayTake)
+            {
+                auto deficit = std::chrono::duration<double>((need - tokens) / rate);
+                wait = std::min(wait, std::chrono::duration_cast<std::chrono::milliseconds>(deficit) +
+                                          std::chrono::milliseconds(1));
+            }
+            changed.wait_for(lock, wait);
+        }
+
+        if (lane == UploadLane::Live && --liveWaiting == 0)
+            changed.notify_all(); // Backlog通道可以继续使用剩余的令牌
+        lock.unlock();
+
+        waited[static_cast<int>(lane)] += std::chrono::duration_cast<std::chrono::microseconds>(
+                                              std::chrono::steady_clock::now() - begin)
+                                              .count();
+    }
+} // namespace VideoStreamer
@@ -0,0 +1,159 @@
+#pragma once
+#include "config.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <vector>
+
+namespace VideoStreamer
+{
+    /**
+     * 上传优先级通道
+     */
+    enum class UploadLane
+    {
+        Live = 0,   // 新分段：有令牌就发送
+        Backlog = 1 // spool中的积压：只在没有新分段等待时使用剩余的令牌
+    };
+
+    /**
+     * BandwidthShaper类，所有上传请求共享的令牌桶限速器
+     * 令牌按当前时段的带宽上限匀速补充，桶容量为uploadBurstBytes；
+     * Live通道有请求在等待时Backlog通道不取令牌，因此积压只占用新分段用剩的带宽
+     * 线程安全，可被多个请求线程和分片上传线程同时调用
+     */
+    class BandwidthShaper
+    {
+    public:
+        explicit BandwidthShaper(const AppConfig &cfg);
+
+        /**
+         * 取得发送bytes字节的令牌，必要时阻塞等待；当前时段不限速时立即返回
+         */
+        void acquire(size_t bytes, UploadLane lane);
+
+        /**
+         * 是否配置了限速（任一时段有上限）
+         */
+        bool enabled() const { return limited; }
+
+        /**
+         * 当前时段的带宽上限（字节/秒），0表示不限
+         */
+        uint64_t currentRate() const;
+
+        /**
+         * 各通道因限速累计等待的时间（微秒）
+         */
+        uint64_t waitedUs(UploadLane lane) const { return waited[static_cast<int>(lane)]; }
+
+        /**
+         * 每次从桶中取令牌的最大字节数（上传流按该大小分块读取）
+         */
+        size_t chunkBytes() const { return chunk; }
+
+    private:
+        /**
+         * 按经过的时间补充令牌（调用方持有锁）
+         */
+        void refill(std::chrono::steady_clock::time_point now, uint64_t rate);
+
+        // 配置参数
+        AppConfig config;
+        bool limited = false;
+        size_t chunk = 0;
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        double tokens = 0.0;                                // 桶中的令牌（字节）
+        std::chrono::steady_clock::time_point lastRefill;   // 上次补充令牌的时刻
+        size_t liveWaiting = 0;                             // Live通道正在等待的请求数
+
+        std::atomic<uint64_t> waited[2];
+    };
+
+    /**
+     * ThrottledStreamBuf类，按块从底层流读取数据，每块先向BandwidthShaper取令牌
+     * 定位操作直接转发给底层流，OSS SDK计算内容长度和重试回绕不受影响（重发的数据同样计入带宽）
+     */
+    class ThrottledStreamBuf : public std::streambuf
+    {
+    public:
+        ThrottledStreamBuf(std::streambuf *source, BandwidthShaper &shaper, UploadLane lane)
+            : source(source), shaper(shaper), lane(lane), buffer(shaper.chunkBytes())
+        {
+            setg(buffer.data(), buffer.data(), buffer.data());
+        }
+
+    protected:
+        int_type underflow() override
+        {
+            if (gptr() < egptr())
+                return traits_type::to_int_type(*gptr());
+
+            std::streamsize available = source->in_avail();
+            std::streamsize want = static_cast<std::streamsize>(buffer.size());
+            if (available > 0)
+                want = std::min(want, available);
+            std::streamsize got = source->sgetn(buffer.data(), want);
+            if (got <= 0)
+                return traits_type::eof();
+            shaper.acquire(static_cast<size_t>(got), lane);
+            setg(buffer.data(), buffer.data(), buffer.data() + got);
+            return traits_type::to_int_type(*gptr());
+        }
+
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+        {
+            // 缓冲中尚未读出的数据要从底层流的位置中扣除
+            if (dir == std::ios_base::cur)
+                off -= egptr() - gptr();
+            setg(buffer.data(), buffer.data(), buffer.data());
+            return source->pubseekoff(off, dir, which);
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+        {
+            setg(buffer.data(), buffer.data(), buffer.data());
+            return source->pubseekpos(pos, which);
+        }
+
+        std::streamsize showmanyc() override
+        {
+            return source->in_avail();
+        }
+
+    private:
+        std::streambuf *source;
+        BandwidthShaper &shaper;
+        UploadLane lane;
+        std::vector<char> buffer;
+    };
+
+    /**
+     * ThrottledStream类，包装上传内容的iostream，可直接传给PutObjectRequest/UploadPartRequest
+     * 持有被包装的流，保证上传期间底层数据有效
+     */
+    class ThrottledStream : public std::iostream
+    {
+    public:
+        ThrottledStream(std::shared_ptr<std::iostream> inner, BandwidthShaper &shaper, UploadLane lane)
+            : std::iostream(nullptr),
+              inner(std::move(inner)),
+              streamBuf(this->inner->rdbuf(), shaper, lane)
+        {
+            rdbuf(&streamBuf);
+        }
+
+    private:
+        std::shared_ptr<std::iostream> inner;
+        ThrottledStreamBuf streamBuf;
+    };
+} // namespace VideoStreamer
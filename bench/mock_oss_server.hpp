@@ -0,0 +1,216 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace VideoStreamer
+{
+    /**
+     * MockOssServer类，本地的最小化OSS对象存储模拟服务（仅用于基准测试）
+     * 支持PutObject、分片上传（Initiate/UploadPart/Complete），请求体读取后直接丢弃；
+     * latencyMs用于模拟每个请求的网络往返延迟
+     */
+    class MockOssServer
+    {
+    public:
+        explicit MockOssServer(int latencyMs = 0) : latency(latencyMs)
+        {
+            listenFd = socket(AF_INET, SOCK_STREAM, 0);
+            int reuse = 1;
+            setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+            sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = 0; // 由系统分配端口
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t len = sizeof(addr);
+            if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(listenFd, 64) != 0 ||
+                getsockname(listenFd, reinterpret_cast<sockaddr *>(&addr), &len) != 0)
+            {
+                close(listenFd);
+                throw std::runtime_error("[MockOssServer] 监听失败");
+            }
+            boundPort = ntohs(addr.sin_port);
+
+            running = true;
+            acceptThread = std::thread(&MockOssServer::acceptLoop, this);
+        }
+
+        ~MockOssServer()
+        {
+            running = false;
+            acceptThread.join();
+            close(listenFd);
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto &t : clients)
+                t.join();
+        }
+
+        MockOssServer(const MockOssServer &) = delete;
+        MockOssServer &operator=(const MockOssServer &) = delete;
+
+        int port() const { return boundPort; }
+
+        /**
+         * 已接收的请求体总字节数
+         */
+        uint64_t bytesReceived() const { return received; }
+
+    private:
+        void acceptLoop()
+        {
+            while (running)
+            {
+                pollfd pfd{listenFd, POLLIN, 0};
+                if (poll(&pfd, 1, 100) <= 0)
+                    continue;
+                int fd = accept(listenFd, nullptr, nullptr);
+                if (fd < 0)
+                    continue;
+                std::lock_guard<std::mutex> lock(mutex);
+                clients.emplace_back(&MockOssServer::serve, this, fd);
+            }
+        }
+
+        // 读取至少一个字节，超时或连接关闭返回false
+        bool fill(int fd, std::string &buffer)
+        {
+            while (running)
+            {
+                pollfd pfd{fd, POLLIN, 0};
+                int ready = poll(&pfd, 1, 100);
+                if (ready < 0)
+                    return false;
+                if (ready == 0)
+                    continue;
+                char chunk[64 * 1024];
+                ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+                if (n <= 0)
+                    return false;
+                buffer.append(chunk, static_cast<size_t>(n));
+                return true;
+            }
+            return false;
+        }
+
+        void sendAll(int fd, const std::string &data)
+        {
+            size_t sent = 0;
+            while (sent < data.size())
+            {
+                ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0)
+                    return;
+                sent += static_cast<size_t>(n);
+            }
+        }
+
+        static std::string headerValue(const std::string &headers, const std::string &name)
+        {
+            std::string lower = headers;
+            std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+            auto pos = lower.find("\r\n" + name + ":");
+            if (pos == std::string::npos)
+                return "";
+            pos += name.size() + 3;
+            auto end = headers.find("\r\n", pos);
+            std::string value = headers.substr(pos, end - pos);
+            value.erase(0, value.find_first_not_of(' '));
+            return value;
+        }
+
+        void serve(int fd)
+        {
+            std::string buffer;
+            while (running)
+            {
+                // 读取请求头
+                size_t headerEnd;
+                while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos)
+                {
+                    if (!fill(fd, buffer))
+                    {
+                        close(fd);
+                        return;
+                    }
+                }
+                std::string headers = buffer.substr(0, headerEnd + 2);
+                buffer.erase(0, headerEnd + 4);
+
+                std::string method = headers.substr(0, headers.find(' '));
+                size_t targetBegin = method.size() + 1;
+                std::string target = headers.substr(targetBegin, headers.find(' ', targetBegin) - targetBegin);
+
+                if (headerValue(headers, "expect") == "100-continue")
+                    sendAll(fd, "HTTP/1.1 100 Continue\r\n\r\n");
+
+                // 读取并丢弃请求体
+                std::string lengthValue = headerValue(headers, "content-length");
+                uint64_t remaining = lengthValue.empty() ? 0 : std::stoull(lengthValue);
+                received += remaining;
+                while (remaining > 0)
+                {
+                    if (buffer.empty() && !fill(fd, buffer))
+                    {
+                        close(fd);
+                        return;
+                    }
+                    size_t take = static_cast<size_t>(std::min<uint64_t>(remaining, buffer.size()));
+                    buffer.erase(0, take);
+                    remaining -= take;
+                }
+
+                if (latency > 0)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(latency));
+
+                std::string body;
+                if (method == "POST" && target.find("uploads") != std::string::npos)
+                {
+                    body = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><InitiateMultipartUploadResult>"
+                           "<Bucket>bench</Bucket><Key>bench</Key><UploadId>upload-" +
+                           std::to_string(++requestCounter) + "</UploadId></InitiateMultipartUploadResult>";
+                }
+                else if (method == "POST" && target.find("uploadId") != std::string::npos)
+                {
+                    body = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><CompleteMultipartUploadResult>"
+                           "<Location>bench</Location><Bucket>bench</Bucket><Key>bench</Key>"
+                           "<ETag>\"mock-etag\"</ETag></CompleteMultipartUploadResult>";
+                }
+
+                std::string response = "HTTP/1.1 200 OK\r\n";
+                response += "x-oss-request-id: mock-" + std::to_string(++requestCounter) + "\r\n";
+                response += "ETag: \"mock-etag-" + std::to_string(requestCounter.load()) + "\"\r\n";
+                if (!body.empty())
+                    response += "Content-Type: application/xml\r\n";
+                response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+                response += "Connection: keep-alive\r\n\r\n";
+                response += body;
+                sendAll(fd, response);
+            }
+            close(fd);
+        }
+
+        int latency;
+        int listenFd = -1;
+        int boundPort = 0;
+        std::atomic<bool> running{false};
+        std::atomic<uint64_t> received{0};
+        std::atomic<uint64_t> requestCounter{0};
+        std::thread acceptThread;
+        std::mutex mutex;
+        std::vector<std::thread> clients;
+    };
+} // namespace VideoStreamer
@@ -0,0 +1,672 @@
+/**
+ * 热路径微基准测试：队列、帧存储（写盘、事件历史窗口）、编码、运动检测、上传
+ * 每个用例输出一行JSON到stdout，便于在不同提交之间对比：
+ *   ./stream_bench [queue|store|encode|motion|upload|all] [--quick] [--label <提交号>] > bench_output.txt
+ */
+#include "bandwidth_shaper.hpp"
+#include "config.hpp"
+#include "encoding_session.hpp"
+#include "event_recorder.hpp"
+#include "frame_source.hpp"
+#include "frame_store.hpp"
+#include "lock_free_queue.hpp"
+#include "motion_detector.hpp"
+#include "oss_uploader.hpp"
+#include "pixel_convert.hpp"
+#include "thread_safe_queue.hpp"
+#include "video_encoder.hpp"
+#include "mock_oss_server.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include <opencv2/opencv.hpp>
+
+using namespace VideoStreamer;
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+    std::string label;  // 结果标签（例如提交号）
+    bool quick = false; // 缩短迭代次数
+
+    // 结果写到stdout（std::cout已重定向到stderr，用于各模块的日志）
+    void emit(const std::string &line)
+    {
+        std::printf("%s\n", line.c_str());
+        std::fflush(stdout);
+    }
+
+    double elapsedNs(Clock::time_point begin)
+    {
+        return std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+    }
+
+    double percentile(std::vector<double> samples, double p)
+    {
+        if (samples.empty())
+            return 0.0;
+        std::sort(samples.begin(), samples.end());
+        size_t i = static_cast<size_t>(p * (samples.size() - 1));
+        return samples[i];
+    }
+
+    /**
+     * 输出一条结果（JSON行），samplesNs为每次操作的耗时，bytes为每次操作处理的字节数
+     */
+    void report(const std::string &suite, const std::string &name, const std::vector<double> &samplesNs,
+                double bytesPerOp = 0.0)
+    {
+        double total = std::accumulate(samplesNs.begin(), samplesNs.end(), 0.0);
+        double mean = samplesNs.empty() ? 0.0 : total / samplesNs.size();
+        std::ostringstream line;
+        line << "{\"suite\":\"" << suite << "\",\"case\":\"" << name << "\",\"label\":\"" << label << "\""
+             << ",\"iterations\":" << samplesNs.size()
+             << ",\"mean_ns\":" << static_cast<uint64_t>(mean)
+             << ",\"p50_ns\":" << static_cast<uint64_t>(percentile(samplesNs, 0.50))
+             << ",\"p99_ns\":" << static_cast<uint64_t>(percentile(samplesNs, 0.99))
+             << ",\"ops_per_sec\":" << (mean > 0 ? 1e9 / mean : 0.0);
+        if (bytesPerOp > 0)
+            line << ",\"mb_per_sec\":" << (mean > 0 ? bytesPerOp / mean * 1e9 / (1024 * 1024) : 0.0);
+        line << "}";
+        emit(line.str());
+    }
+
+    /**
+     * 吞吐型结果：总操作数和总耗时
+     */
+    void reportThroughput(const std::string &suite, const std::string &name, uint64_t ops, double totalNs)
+    {
+        std::ostringstream line;
+        line << "{\"suite\":\"" << suite << "\",\"case\":\"" << name << "\",\"label\":\"" << label << "\""
+             << ",\"iterations\":" << ops
+             << ",\"mean_ns\":" << static_cast<uint64_t>(totalNs / std::max<uint64_t>(ops, 1))
+             << ",\"ops_per_sec\":" << (totalNs > 0 ? ops * 1e9 / totalNs : 0.0) << "}";
+        emit(line.str());
+    }
+
+    // 生成指定分辨率的合成MJPEG帧
+    std::vector<FramePtr> syntheticFrames(int width, int height, size_t count)
+    {
+        AppConfig cfg;
+        cfg.frameSource = FrameSourceType::Synthetic;
+        cfg.targetWidth = width;
+        cfg.targetHeight = height;
+        cfg.freeRun = true;
+        cfg.syntheticFrameCount = static_cast<int>(std::min<size_t>(count, 30));
+        SyntheticFrameSource source(cfg);
+
+        std::vector<FramePtr> frames;
+        while (frames.size() < count)
+        {
+            auto frame = source.getFrame(1000);
+            if (frame)
+                frames.push_back(frame);
+        }
+        return frames;
+    }
+
+    // 把合成的MJPEG帧转换为未压缩的YUYV或NV12帧（模拟相机直接输出未压缩格式）
+    std::vector<FramePtr> rawFrames(const std::vector<FramePtr> &jpegFrames, ob_format format)
+    {
+        std::vector<FramePtr> frames;
+        for (const auto &jpeg : jpegFrames)
+        {
+            cv::Mat bgr = cv::imdecode(cv::Mat(*jpeg->payload), cv::IMREAD_COLOR);
+            cv::Mat i420;
+            cv::cvtColor(bgr, i420, cv::COLOR_BGR2YUV_I420);
+            const int width = bgr.cols, height = bgr.rows;
+            const uint8_t *y = i420.data;
+            const uint8_t *u = y + width * height;
+            const uint8_t *v = u + (width / 2) * (height / 2);
+
+            auto data = std::make_shared<std::vector<uint8_t>>(rawFrameSize(format, width, height));
+            uint8_t *out = data->data();
+            for (int row = 0; row < height; ++row)
+            {
+                for (int x = 0; x < width; x += 2)
+                {
+                    const size_t c = static_cast<size_t>(row / 2) * (width / 2) + x / 2;
+                    if (format == OB_FORMAT_YUYV)
+                    {
+                        uint8_t *p = out + (static_cast<size_t>(row) * width + x) * 2;
+                        p[0] = y[row * width + x];
+                        p[1] = u[c];
+                        p[2] = y[row * width + x + 1];
+                        p[3] = v[c];
+                    }
+                    else
+                    {
+                        out[row * width + x] = y[row * width + x];
+                        out[row * width + x + 1] = y[row * width + x + 1];
+                        if (row % 2 == 0)
+                        {
+                            out[width * height + c * 2] = u[c];
+                            out[width * height + c * 2 + 1] = v[c];
+                        }
+                    }
+                }
+            }
+
+            auto frame = std::make_shared<Frame>(*jpeg);
+            frame->payload = data;
+            frame->format = format;
+            frames.push_back(frame);
+        }
+        return frames;
+    }
+
+    // 进程所有线程消耗的CPU时间（纳秒），libx264的工作线程也计入
+    double processCpuNs()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return ts.tv_sec * 1e9 + ts.tv_nsec;
+    }
+
+    // ---------------- 队列 ----------------
+
+    void benchThreadSafeQueue(int producers, int consumers, size_t items)
+    {
+        ThreadSafeQueue<uint64_t> queue(1024, OverflowPolicy::Block);
+        std::atomic<size_t> consumed{0};
+        auto begin = Clock::now();
+
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p)
+        {
+            threads.emplace_back([&, p]()
+                                 {
+                                     for (size_t i = p; i < items; i += producers)
+                                         queue.push(i);
+                                 });
+        }
+        for (int c = 0; c < consumers; ++c)
+        {
+            threads.emplace_back([&]()
+                                 {
+                                     uint64_t value;
+                                     while (queue.waitPop(value))
+                                         ++consumed;
+                                 });
+        }
+        for (int p = 0; p < producers; ++p)
+            threads[p].join();
+        while (consumed < items)
+            std::this_thread::yield();
+        double totalNs = elapsedNs(begin);
+        queue.close();
+        for (size_t i = producers; i < threads.size(); ++i)
+            threads[i].join();
+
+        reportThroughput("queue", "thread_safe_queue_p" + std::to_string(producers) + "_c" + std::to_string(consumers),
+                         items, totalNs);
+    }
+
+    template <typename Queue>
+    void benchLockFreeQueue(const std::string &name, int producers, int consumers, size_t items)
+    {
+        Queue queue(1024);
+        std::atomic<size_t> consumed{0};
+        auto begin = Clock::now();
+
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p)
+        {
+            threads.emplace_back([&, p]()
+                                 {
+                                     for (size_t i = p; i < items; i += producers)
+                                         while (!queue.tryPush(i))
+                                             std::this_thread::yield();
+                                 });
+        }
+        for (int c = 0; c < consumers; ++c)
+        {
+            threads.emplace_back([&]()
+                                 {
+                                     uint64_t value;
+                                     while (consumed < items)
+                                     {
+                                         if (queue.tryPop(value))
+                                             ++consumed;
+                                         else
+                                             std::this_thread::yield();
+                                     }
+                                 });
+        }
+        for (auto &t : threads)
+            t.join();
+
+        reportThroughput("queue", name + "_p" + std::to_string(producers) + "_c" + std::to_string(consumers),
+                         items, elapsedNs(begin));
+    }
+
+    void benchQueues()
+    {
+        const size_t items = quick ? 20000 : 500000;
+        for (int n : {1, 2, 4})
+            benchThreadSafeQueue(n, n, items);
+        benchLockFreeQueue<SpscQueue<uint64_t>>("spsc_queue", 1, 1, items);
+        for (int n : {1, 2, 4})
+            benchLockFreeQueue<MpmcQueue<uint64_t>>("mpmc_queue", n, n, items);
+    }
+
+    // ---------------- 帧存储 ----------------
+
+    void benchFrameStore(const std::string &resolution, int width, int height, FrameStorage storage)
+    {
+        const size_t count = quick ? 30 : 300;
+        auto frames = syntheticFrames(width, height, 30);
+
+        AppConfig cfg;
+        cfg.frameStorage = storage;
+        cfg.tempDir = "./bench_tmp/";
+        cfg.maxQueueSize = 64;
+        cfg.deletePolicy = DeletePolicy::DeleteOnSuccess;
+        FrameStore store(cfg);
+
+        std::vector<double> samples;
+        size_t bytes = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            // 每次复制帧对象，避免同一个帧的磁盘路径被重复使用
+            auto frame = std::make_shared<Frame>(*frames[i % frames.size()]);
+            frame->index = i;
+            frame->filePath.clear();
+            bytes += frame->dataSize();
+
+            auto begin = Clock::now();
+            store.push(frame);
+            samples.push_back(elapsedNs(begin));
+
+            size_t dropped = 0;
+            auto batch = store.popBatch(8, dropped);
+            store.retire(batch);
+        }
+        store.clear();
+
+        report("store", std::string(storage == FrameStorage::Disk ? "disk_" : "memory_") + resolution, samples,
+               static_cast<double>(bytes) / count);
+    }
+
+    // 事件录制的历史窗口：空闲时每帧的开销，以及触发时交出整个窗口的耗时
+    void benchPreRoll()
+    {
+        const size_t count = quick ? 300 : 3000;
+        auto frames = syntheticFrames(1280, 720, 30);
+
+        AppConfig cfg;
+        cfg.recordingMode = RecordingMode::Event;
+        EventRecorder recorder(cfg);
+        auto captureTime = std::chrono::system_clock::now();
+        const auto interval = std::chrono::microseconds(1000000 / cfg.targetFPS);
+
+        std::vector<double> samples;
+        std::vector<FramePtr> out;
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto frame = std::make_shared<Frame>(*frames[i % frames.size()]);
+            frame->captureTime = captureTime;
+            captureTime += interval;
+            auto begin = Clock::now();
+            recorder.admit(frame, out);
+            samples.push_back(elapsedNs(begin));
+        }
+        report("store", "preroll_idle_720p", samples, static_cast<double>(frames.front()->dataSize()));
+
+        const size_t windowFrames = recorder.windowFrames();
+        recorder.trigger(captureTime);
+        auto frame = std::make_shared<Frame>(*frames.front());
+        frame->captureTime = captureTime;
+        auto begin = Clock::now();
+        recorder.admit(frame, out);
+        report("store", "preroll_trigger_" + std::to_string(windowFrames) + "frames", {elapsedNs(begin)});
+    }
+
+    void benchStore()
+    {
+        for (auto storage : {FrameStorage::Disk, FrameStorage::Memory})
+        {
+            benchFrameStore("720p", 1280, 720, storage);
+            benchFrameStore("1080p", 1920, 1080, storage);
+        }
+        benchPreRoll();
+    }
+
+    // ---------------- 编码 ----------------
+
+    void benchEncode()
+    {
+        const int rounds = quick ? 2 : 10;
+        auto frames = syntheticFrames(1280, 720, 32);
+
+        AppConfig cfg;
+        cfg.encoderBackend = EncoderBackend::Libav;
+        VideoEncoder encoder(cfg);
+
+        for (size_t batchSize : {1, 4, 8, 16, 32})
+        {
+            std::vector<FramePtr> batch(frames.begin(), frames.begin() + batchSize);
+            std::vector<double> samples;
+            for (int r = 0; r < rounds; ++r)
+            {
+                std::vector<std::vector<uint8_t>> outputs(1);
+                auto begin = Clock::now();
+                encoder.encode(batch, outputs);
+                samples.push_back(elapsedNs(begin));
+            }
+            report("encode", "libav_720p_batch" + std::to_string(batchSize), samples);
+        }
+
+        // MJPEG与未压缩输入的对比：每帧准备编码输入（JPEG解码+像素格式转换 / 向量化转换）的耗时，
+        // 以及完整编码时每帧消耗的CPU时间（含libx264线程）
+        {
+            std::cerr << "[stream_bench] 像素转换使用 " << pixelConvertBackend() << std::endl;
+            struct Input
+            {
+                const char *name;
+                std::vector<FramePtr> frames;
+            };
+            std::vector<Input> inputs;
+            inputs.push_back({"mjpeg", frames});
+            inputs.push_back({"yuyv", rawFrames(frames, OB_FORMAT_YUYV)});
+            inputs.push_back({"nv12", rawFrames(frames, OB_FORMAT_NV12)});
+            for (const auto &input : inputs)
+            {
+                LibavEncoder prepareOnly(cfg, EncoderOptions());
+                std::vector<double> samples;
+                for (int r = 0; r < rounds * 30; ++r)
+                {
+                    const Frame &frame = *input.frames[r % input.frames.size()];
+                    auto begin = Clock::now();
+                    prepareOnly.prepareFrame(frame);
+                    samples.push_back(elapsedNs(begin));
+                }
+                report("encode", std::string("prepare_720p_") + input.name, samples,
+                       static_cast<double>(input.frames.front()->dataSize()));
+
+                VideoEncoder batchEncoder(cfg);
+                std::vector<FramePtr> batch(input.frames.begin(), input.frames.begin() + 16);
+                std::vector<double> cpuSamples;
+                for (int r = 0; r < rounds; ++r)
+                {
+                    std::vector<std::vector<uint8_t>> outputs(1);
+                    double cpuBegin = processCpuNs();
+                    batchEncoder.encode(batch, outputs);
+                    cpuSamples.push_back((processCpuNs() - cpuBegin) / batch.size());
+                }
+                report("encode", std::string("cpu_per_frame_720p_") + input.name, cpuSamples);
+            }
+        }
+
+        // 编码阶梯：720p@3M + 360p@500k，一次解码共享缩放画面 vs 两个编码器各自解码
+        {
+            AppConfig ladderCfg = cfg;
+            Rendition archive, preview;
+            archive.bitRate = 3000000;
+            preview.width = 640;
+            preview.height = 360;
+            preview.bitRate = 500000;
+            preview.uploadPrefix = "preview/";
+            ladderCfg.renditions = {archive, preview};
+            AppConfig archiveCfg = cfg, previewCfg = cfg;
+            archiveCfg.renditions = {archive};
+            previewCfg.renditions = {preview};
+
+            VideoEncoder shared(ladderCfg), archiveOnly(archiveCfg), previewOnly(previewCfg);
+            std::vector<FramePtr> batch(frames.begin(), frames.begin() + 16);
+            std::vector<double> sharedSamples, separateSamples;
+            for (int r = 0; r < rounds; ++r)
+            {
+                std::vector<std::vector<uint8_t>> outputs(2);
+                double cpuBegin = processCpuNs();
+                shared.encode(batch, outputs);
+                sharedSamples.push_back((processCpuNs() - cpuBegin) / batch.size());
+
+                std::vector<std::vector<uint8_t>> archiveOut(1), previewOut(1);
+                cpuBegin = processCpuNs();
+                archiveOnly.encode(batch, archiveOut);
+                previewOnly.encode(batch, previewOut);
+                separateSamples.push_back((processCpuNs() - cpuBegin) / batch.size());
+            }
+            report("encode", "cpu_per_frame_ladder_720p_360p_shared", sharedSamples);
+            report("encode", "cpu_per_frame_ladder_720p_360p_separate", separateSamples);
+        }
+
+        // MJPEG直通：JPEG数据直接封装，每帧的耗时即封装开销
+        for (auto container : {SegmentContainer::Matroska, SegmentContainer::FragmentedMp4, SegmentContainer::Avi})
+        {
+            AppConfig passthroughCfg;
+            passthroughCfg.encoderBackend = EncoderBackend::Passthrough;
+            passthroughCfg.segmentContainer = container;
+            passthroughCfg.tempDir = "./bench_tmp/";
+            size_t segments = 0;
+            EncodingSession session(passthroughCfg, [&](const Segment &)
+                                    { ++segments; });
+
+            std::vector<double> samples;
+            for (int r = 0; r < rounds * 30; ++r)
+            {
+                auto frame = std::make_shared<Frame>(*frames[r % frames.size()]);
+                frame->timestampUs = static_cast<uint64_t>(r + 1) * 1000000 / passthroughCfg.targetFPS;
+                auto begin = Clock::now();
+                session.push(frame);
+                samples.push_back(elapsedNs(begin));
+            }
+            static const char *names[] = {"ts", "mp4", "mkv", "avi"};
+            report("encode", std::string("passthrough_720p_") + names[static_cast<int>(container)], samples,
+                   static_cast<double>(frames.front()->dataSize()));
+        }
+
+        // 连续编码 + 实时输出（MPEG-TS over UDP发往本机，没有接收端也不影响发送）
+        {
+            AppConfig liveCfg;
+            liveCfg.tempDir = "./bench_tmp/";
+            liveCfg.liveOutputUrl = "udp://127.0.0.1:47000?pkt_size=1316";
+            EncodingSession session(liveCfg, [](const Segment &) {});
+            std::vector<double> samples;
+            auto captureTime = std::chrono::system_clock::now();
+            for (int r = 0; r < rounds * 30; ++r)
+            {
+                auto frame = std::make_shared<Frame>(*frames[r % frames.size()]);
+                frame->captureTime = captureTime + std::chrono::microseconds(r * 1000000 / liveCfg.targetFPS);
+                auto begin = Clock::now();
+                session.push(frame);
+                samples.push_back(elapsedNs(begin));
+            }
+            report("encode", "session_live_udp_720p", samples);
+            std::cerr << "[stream_bench] 实时输出发送 " << session.live()->sentPackets() << " 个数据包，丢弃 "
+                      << session.live()->droppedPackets() << std::endl;
+        }
+    }
+
+    // ---------------- 运动检测 ----------------
+
+    void benchMotion()
+    {
+        const size_t count = quick ? 60 : 600;
+
+        // 比较核心：两幅720p/8的亮度图
+        std::vector<uint8_t> a(160 * 90), b(160 * 90);
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            a[i] = static_cast<uint8_t>(i * 7);
+            b[i] = static_cast<uint8_t>(i * 7 + (i % 13 == 0 ? 40 : 3));
+        }
+        std::vector<double> samples;
+        size_t changed = 0;
+        for (size_t i = 0; i < count * 10; ++i)
+        {
+            auto begin = Clock::now();
+            changed += countChangedPixels(a.data(), b.data(), a.size(), 12);
+            samples.push_back(elapsedNs(begin));
+        }
+        if (changed == 0)
+            std::cerr << "[stream_bench] 运动检测核心结果异常" << std::endl;
+        report("motion", "luma_diff_160x90", samples, static_cast<double>(a.size()));
+
+        // 完整分析：低分辨率解码 + 比较
+        for (auto res : {std::make_pair(1280, 720), std::make_pair(1920, 1080)})
+        {
+            auto frames = syntheticFrames(res.first, res.second, 30);
+            AppConfig cfg;
+            MotionDetector detector(cfg);
+            samples.clear();
+            for (size_t i = 0; i < count; ++i)
+            {
+                auto frame = std::make_shared<Frame>(*frames[i % frames.size()]);
+                auto begin = Clock::now();
+                detector.admit(*frame);
+                samples.push_back(elapsedNs(begin));
+            }
+            report("motion", "analyze_" + std::to_string(res.second) + "p", samples);
+        }
+    }
+
+    // ---------------- 上传 ----------------
+
+    // 限速时新分段在积压占满带宽的情况下取得令牌的等待时间（每块64KB，上限8MB/s）
+    void benchShaper()
+    {
+        AppConfig cfg;
+        cfg.uploadRateBytesPerSec = 8 * 1024 * 1024;
+        cfg.uploadBurstBytes = 256 * 1024;
+        BandwidthShaper shaper(cfg);
+        const size_t chunk = shaper.chunkBytes();
+
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> backlog;
+        for (int i = 0; i < 2; ++i)
+        {
+            backlog.emplace_back([&]()
+                                 {
+                                     while (!stop)
+                                         shaper.acquire(chunk, UploadLane::Backlog);
+                                 });
+        }
+
+        const int chunks = quick ? 16 : 128;
+        std::vector<double> samples;
+        for (int i = 0; i < chunks; ++i)
+        {
+            auto begin = Clock::now();
+            shaper.acquire(chunk, UploadLane::Live);
+            samples.push_back(elapsedNs(begin));
+        }
+        stop = true;
+        for (auto &t : backlog)
+            t.join();
+        report("upload", "shaper_live_under_backlog_64KB", samples, static_cast<double>(chunk));
+    }
+
+    void benchUpload()
+    {
+        const int rounds = quick ? 3 : 20;
+        MockOssServer server;
+
+        AppConfig cfg;
+        cfg.endpoint = "http://127.0.0.1:" + std::to_string(server.port());
+        cfg.bucket = "bench";
+        cfg.accessKeyId = "bench";
+        cfg.accessKeySecret = "bench";
+        cfg.uploadPrefix = "bench/";
+        cfg.requestTimeoutMs = 10000;
+        cfg.segmentManifest = false; // 只测分段本身的上传，清单追加另算
+        OSSUploader uploader(cfg);
+
+        for (size_t size : {256 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024})
+        {
+            Segment segment;
+            segment.path = "./bench_tmp/upload.ts";
+            segment.extension = ".ts";
+            segment.data = std::make_shared<std::vector<uint8_t>>(size, 0x47);
+            segment.bytes = size;
+
+            std::vector<double> samples;
+            for (int r = 0; r < rounds; ++r)
+            {
+                auto begin = Clock::now();
+                if (!uploader.uploadSegment(segment))
+                    std::cerr << "[stream_bench] 上传失败" << std::endl;
+                samples.push_back(elapsedNs(begin));
+            }
+            report("upload", "mock_oss_" + std::to_string(size / 1024) + "KB", samples, static_cast<double>(size));
+        }
+
+        // 异步接口：一批小分段同时提交，共享客户端的连接池
+        const size_t batch = quick ? 8 : 64;
+        Segment segment;
+        segment.path = "./bench_tmp/upload_async.ts";
+        segment.extension = ".ts";
+        segment.data = std::make_shared<std::vector<uint8_t>>(256 * 1024, 0x47);
+        segment.bytes = segment.data->size();
+        std::vector<std::future<bool>> pending;
+        auto begin = Clock::now();
+        for (size_t i = 0; i < batch; ++i)
+            pending.push_back(uploader.uploadSegmentAsync(segment));
+        for (auto &f : pending)
+        {
+            if (!f.get())
+                std::cerr << "[stream_bench] 上传失败" << std::endl;
+        }
+        reportThroughput("upload", "mock_oss_async_256KB_x" + std::to_string(cfg.uploadThreads), batch, elapsedNs(begin));
+
+        benchShaper();
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::string suite = "all";
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--quick")
+            quick = true;
+        else if (arg == "--label" && i + 1 < argc)
+            label = argv[++i];
+        else if (arg == "queue" || arg == "store" || arg == "encode" || arg == "motion" || arg == "upload" ||
+                 arg == "all")
+            suite = arg;
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [queue|store|encode|motion|upload|all] [--quick] [--label <name>]" << std::endl;
+            return 1;
+        }
+    }
+
+    // 各模块的日志输出到stderr，stdout只保留JSON结果
+    std::streambuf *stdoutBuf = std::cout.rdbuf(std::cerr.rdbuf());
+
+    AlibabaCloud::OSS::InitializeSdk();
+    try
+    {
+        auto run = [&](const std::string &name, void (*fn)())
+        {
+            if (suite != "all" && suite != name)
+                return;
+            fn();
+        };
+        run("queue", benchQueues);
+        run("store", benchStore);
+        run("encode", benchEncode);
+        run("motion", benchMotion);
+        run("upload", benchUpload);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "[stream_bench] " << e.what() << std::endl;
+    }
+    AlibabaCloud::OSS::ShutdownSdk();
+
+    std::cout.rdbuf(stdoutBuf);
+    return 0;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace VideoStreamer
+{
+    /**
+     * BufferPool类，复用帧数据缓冲区，避免每帧都重新分配内存
+     * 通过acquire获取的缓冲区在最后一个引用释放时自动归还到池中
+     */
+    class BufferPool : public std::enable_shared_from_this<BufferPool>
+    {
+    public:
+        using Buffer = std::vector<uint8_t>;
+
+        /**
+         * maxPooled为池中最多保留的空闲缓冲区数量
+         */
+        static std::shared_ptr<BufferPool> create(size_t maxPooled)
+        {
+            return std::shared_ptr<BufferPool>(new BufferPool(maxPooled));
+        }
+
+        /**
+         * 获取一个大小为size的缓冲区：复用的缓冲保留上次的数据，超出原大小的部分由resize清零，调用方需自行写满
+         */
+        std::shared_ptr<Buffer> acquire(size_t size)
+        {
+            Buffer *buffer = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!freeList.empty())
+                {
+                    buffer = freeList.back().release();
+                    freeList.pop_back();
+                }
+            }
+            if (!buffer)
+                buffer = new Buffer();
+            buffer->resize(size);
+
+            std::weak_ptr<BufferPool> weakPool = shared_from_this();
+            return std::shared_ptr<Buffer>(buffer, [weakPool](Buffer *b)
+                                           {
+                                               if (auto pool = weakPool.lock())
+                                                   pool->release(b);
+                                               else
+                                                   delete b; });
+        }
+
+        /**
+         * 当前空闲缓冲区数量
+         */
+        size_t idleCount() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return freeList.size();
+        }
+
+    private:
+        explicit BufferPool(size_t maxPooled) : maxPooled(maxPooled) {}
+
+        void release(Buffer *buffer)
+        {
+            std::unique_ptr<Buffer> holder(buffer);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (freeList.size() < maxPooled)
+                freeList.push_back(std::move(holder));
+        }
+
+        size_t maxPooled;                             // 池中最多保留的缓冲区数量
+        std::vector<std::unique_ptr<Buffer>> freeList; // 空闲缓冲区
+        mutable std::mutex mutex;                     // 保护空闲列表
+    };
+} // namespace VideoStreamer
@@ -4,8 +4,8 @@ namespace VideoStreamer
 {
     CameraCapture::CameraCapture(const AppConfig &cfg) : config(cfg)
     {
-        // 初始化摄像头的捕获管道
-        setupPipeline();
+        // 根据配置创建数据源（摄像头源会在此启动数据流管道）
+        source = createFrameSource(config);
     }
 
     CameraCapture::~CameraCapture()
@@ -14,31 +14,35 @@ namespace VideoStreamer
     }
 
     // 获取一帧图像，timeoutMs为超时时间（单位毫秒），默认1000ms
-    std::shared_ptr<ob::ColorFrame> CameraCapture::getFrame(int timeoutMs)
+    FramePtr CameraCapture::getFrame(int timeoutMs)
     {
-        auto frameSet = pipeline.waitForFrames(timeoutMs);
-        
-        return frameSet && frameSet->colorFrame() ? frameSet->colorFrame() : nullptr;
+        auto frame = source->getFrame(timeoutMs);
+        if (frame)
+            countFrame();
+        return frame;
     }
 
-    /**
-     * 设置摄像头的数据流管道，包括流的配置
-     */
-    void CameraCapture::setupPipeline()
+    bool CameraCapture::start(FrameSource::FrameCallback callback)
     {
-        auto profiles = pipeline.getStreamProfileList(OB_SENSOR_COLOR);
-        
-        auto profile = profiles->getVideoStreamProfile(
-            config.targetWidth,
-            config.targetHeight,
-            config.colorFormat,
-            config.targetFPS);
+        return source->start([this, callback](FramePtr frame)
+                             {
+                                 countFrame();
+                                 callback(std::move(frame));
+                             });
+    }
 
-        auto cfg = std::make_shared<ob::Config>();
-        cfg->enableStream(profile);
-        
-        // 启动数据流管道
-        pipeline.start(cfg);
+    void CameraCapture::countFrame()
+    {
+        if (frames++ == 0)
+            firstFrameTime = std::chrono::steady_clock::now();
+    }
+
+    double CameraCapture::averageFps() const
+    {
+        if (frames < 2)
+            return 0.0;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - firstFrameTime;
+        return elapsed.count() > 0 ? (frames - 1) / elapsed.count() : 0.0;
     }
 
     /** 
@@ -46,6 +50,6 @@ namespace VideoStreamer
      */ 
     void CameraCapture::stop()
     {
-        pipeline.stop();  // 停止流
+        source->stop();  // 停止流
     }
 } // namespace VideoStreamer
@@ -1,12 +1,16 @@
 #pragma once
 #include "config.hpp"
+#include "frame.hpp"
+#include "frame_source.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
-#include <libobsensor/ObSensor.hpp>
 
 namespace VideoStreamer
 {
     /**
-     * CameraCapture类用于从摄像头获取视频帧
+     * CameraCapture类用于从摄像头（或回放/合成数据源）获取视频帧
      */
     class CameraCapture
     {
@@ -20,23 +24,48 @@ namespace VideoStreamer
         /**
          * 获取一帧图像，带有超时设置（默认为1000毫秒）
          */
-        std::shared_ptr<ob::ColorFrame> getFrame(int timeoutMs = 1000);
+        FramePtr getFrame(int timeoutMs = 1000);
 
-    private:
         /**
-         *  设置摄像头的数据流管道
+         * 以回调方式采集（captureMode为Callback且数据源支持时）：每帧在数据源线程上调用callback，返回true；
+         * 否则返回false，调用方用getFrame轮询
          */
-        void setupPipeline();
-        
-        /** 
-         * 停止摄像头的流
+        bool start(FrameSource::FrameCallback callback);
+
+        /**
+         * 停止摄像头的流（回调方式下返回后不再有回调），可重复调用
          */
         void stop();
 
+        /**
+         * 已获取的帧数
+         */
+        uint64_t frameCount() const { return frames; }
+
+        /**
+         * 按设备帧号检测到的丢帧数
+         */
+        uint64_t droppedFrames() const { return source->droppedFrames(); }
+
+        /**
+         * 自第一帧以来的平均帧率
+         */
+        double averageFps() const;
+
+    private:
+        /**
+         * 统计一帧
+         */
+        void countFrame();
+
         // 配置文件对象，包含摄像头的相关配置信息
         AppConfig config;
         
-        // 摄像头的数据流管道对象，用于管理摄像头的捕获流程
-        ob::Pipeline pipeline;
+        // 帧数据源，根据配置选择摄像头、回放或合成源
+        std::unique_ptr<FrameSource> source;
+
+        // 帧率统计
+        std::atomic<uint64_t> frames{0};
+        std::chrono::steady_clock::time_point firstFrameTime;
     };
 } // namespace VideoStreamer
@@ -0,0 +1,483 @@
+#include "encoding_session.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+extern "C"
+{
+#include <libavutil/opt.h>
+}
+
+namespace VideoStreamer
+{
+    namespace
+    {
+        // 连续模式的编码参数：关键帧间隔由配置决定，允许B帧和前瞻以提高压缩率；
+        // 启用实时输出时改用零延迟参数（前瞻会带来数秒的编码延迟），压缩率略有下降
+        EncoderOptions sessionOptions(const AppConfig &cfg, const Rendition &rendition)
+        {
+            EncoderOptions opts;
+            opts.bitRate = rendition.bitRate > 0 ? rendition.bitRate : cfg.bitRate;
+            opts.width = rendition.width;
+            opts.height = rendition.height;
+            opts.gopSize = cfg.gopSize;
+            opts.lowLatency = !cfg.liveOutputUrl.empty();
+            opts.globalHeader = cfg.segmentContainer != SegmentContainer::MpegTs; // MPEG-TS以外的容器需要extradata
+            return opts;
+        }
+
+        // 封装格式对应的libavformat封装器名称和文件扩展名
+        const char *containerFormat(SegmentContainer container)
+        {
+            switch (container)
+            {
+            case SegmentContainer::FragmentedMp4:
+                return "mp4";
+            case SegmentContainer::Matroska:
+                return "matroska";
+            case SegmentContainer::Avi:
+                return "avi";
+            default:
+                return "mpegts";
+            }
+        }
+
+        const char *containerExtension(SegmentContainer container)
+        {
+            switch (container)
+            {
+            case SegmentContainer::FragmentedMp4:
+                return ".mp4";
+            case SegmentContainer::Matroska:
+                return ".mkv";
+            case SegmentContainer::Avi:
+                return ".avi";
+            default:
+                return ".ts";
+            }
+        }
+
+        // 内存分段的AVIO缓冲大小
+        const int kIoBufferSize = 64 * 1024;
+
+        // 关键帧索引的最小间隔：直通模式每帧都是关键帧，索引最多每秒一项
+        const std::chrono::milliseconds kIndexInterval(1000);
+
+        // AVIO写回调：在当前位置写入封装器输出（通常是追加，回写文件头时覆盖）
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(61, 0, 0)
+        int writeToBuffer(void *opaque, const uint8_t *data, int size)
+#else
+        int writeToBuffer(void *opaque, uint8_t *data, int size)
+#endif
+        {
+            auto output = static_cast<MemoryOutput *>(opaque);
+            auto &buffer = *output->data;
+            if (output->position == buffer.size())
+            {
+                buffer.insert(buffer.end(), data, data + size);
+            }
+            else
+            {
+                if (output->position + size > buffer.size())
+                    buffer.resize(output->position + size);
+                memcpy(buffer.data() + output->position, data, size);
+            }
+            output->position += size;
+            return size;
+        }
+
+        // AVIO定位回调：封装器结束时回到文件头更新索引/时长
+        int64_t seekInBuffer(void *opaque, int64_t offset, int whence)
+        {
+            auto output = static_cast<MemoryOutput *>(opaque);
+            int64_t size = static_cast<int64_t>(output->data->size());
+            switch (whence & ~AVSEEK_FORCE)
+            {
+            case AVSEEK_SIZE:
+                return size;
+            case SEEK_SET:
+                break;
+            case SEEK_CUR:
+                offset += static_cast<int64_t>(output->position);
+                break;
+            case SEEK_END:
+                offset += size;
+                break;
+            default:
+                return AVERROR(EINVAL);
+            }
+            if (offset < 0)
+                return AVERROR(EINVAL);
+            output->position = static_cast<size_t>(offset);
+            return offset;
+        }
+    } // namespace
+
+    EncodingSession::EncodingSession(const AppConfig &cfg, SegmentHandler handler, const Rendition &rendition)
+        : config(cfg),
+          onSegment(std::move(handler)),
+          renditionName(rendition.name),
+          container(cfg.segmentContainer)
+    {
+        if (!config.tempDir.empty() && config.tempDir.back() != '/')
+        {
+            config.tempDir += '/';
+        }
+
+        if (config.encoderBackend == EncoderBackend::Passthrough)
+        {
+            if (container == SegmentContainer::MpegTs)
+            {
+                std::cerr << "[EncodingSession] MPEG-TS不支持MJPEG，直通模式改用Matroska封装" << std::endl;
+                container = SegmentContainer::Matroska;
+            }
+            // AVI按帧计时（时间戳间隔会被补成空帧），其他容器使用微秒精度的设备时间戳
+            timeBase = container == SegmentContainer::Avi ? AVRational{1, std::max(config.targetFPS, 1)}
+                                                          : AVRational{1, 1000000};
+            passthroughPacket = av_packet_alloc();
+            if (!passthroughPacket)
+            {
+                throw std::runtime_error("[EncodingSession] 内存分配失败");
+            }
+        }
+        else
+        {
+            encoder.reset(new LibavEncoder(config, sessionOptions(config, rendition)));
+            timeBase = AVRational{1, config.targetFPS};
+        }
+
+        if (!config.liveOutputUrl.empty())
+        {
+            if (!encoder && config.liveOutputUrl.compare(0, 6, "rtp://") != 0)
+            {
+                std::cerr << "[EncodingSession] MPEG-TS不支持MJPEG，直通模式的实时输出需要rtp://地址" << std::endl;
+            }
+            else
+            {
+                liveOutput.reset(new LiveOutput(config));
+            }
+        }
+    }
+
+    EncodingSession::~EncodingSession()
+    {
+        try
+        {
+            flush();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "[EncodingSession] 关闭失败: " << e.what() << std::endl;
+        }
+        av_packet_free(&passthroughPacket);
+    }
+
+    void EncodingSession::push(const FramePtr &frame)
+    {
+        if (!encoder)
+        {
+            pushPassthrough(frame);
+            return;
+        }
+
+        if (encoder->prepareFrame(*frame))
+            encodePrepared(*frame);
+    }
+
+    void EncodingSession::push(const FramePtr &frame, PictureLadder &pictures)
+    {
+        if (!encoder)
+        {
+            pushPassthrough(frame);
+            return;
+        }
+
+        if (encoder->preparePicture(pictures))
+            encodePrepared(*frame);
+    }
+
+    void EncodingSession::encodePrepared(const Frame &frame)
+    {
+        // 达到目标后强制下一帧为关键帧，并在该关键帧处切分
+        bool forceKeyframe = false;
+        if (muxer && !cutPending && segmentTargetReached())
+        {
+            cutPending = true;
+            forceKeyframe = true;
+        }
+
+        int64_t pts = assignPts(frame);
+        encoder->encodePrepared(pts, forceKeyframe, [this](AVPacket *pkt)
+                                { handlePacket(pkt); });
+    }
+
+    void EncodingSession::pushPassthrough(const FramePtr &frame)
+    {
+        if (frame->format != OB_FORMAT_MJPG)
+        {
+            std::cerr << "[EncodingSession] 直通模式只支持MJPEG帧，丢弃帧 " << frame->index << std::endl;
+            return;
+        }
+        if (passthroughWidth == 0)
+        {
+            passthroughWidth = static_cast<int>(frame->width);
+            passthroughHeight = static_cast<int>(frame->height);
+        }
+
+        // 每一帧都是关键帧，达到目标后直接在这一帧处切分
+        if (muxer && !cutPending && segmentTargetReached())
+            cutPending = true;
+
+        // 数据包直接引用帧数据，写入封装器期间frame保持有效
+        AVPacket *packet = passthroughPacket;
+        packet->data = const_cast<uint8_t *>(frame->data());
+        packet->size = static_cast<int>(frame->dataSize());
+        packet->pts = packet->dts = assignPts(*frame);
+        packet->duration = av_rescale_q(1, AVRational{1, std::max(config.targetFPS, 1)}, timeBase);
+        packet->flags = AV_PKT_FLAG_KEY;
+        handlePacket(packet);
+        packet->data = nullptr;
+        packet->size = 0;
+    }
+
+    int64_t EncodingSession::assignPts(const Frame &frame)
+    {
+        if (!hasEpoch)
+        {
+            epoch = frame.captureTime;
+            firstTimestampUs = frame.timestampUs;
+            hasEpoch = true;
+        }
+
+        int64_t elapsedUs;
+        if ((!encoder || frame.hardwareTimestamp) && frame.timestampUs != 0)
+        {
+            // 摄像头帧和直通模式使用设备时间戳作为pts，不受采集线程调度抖动的影响；
+            // 设备端丢帧时时间戳之间留出相应的间隔，播放速度仍然正确
+            elapsedUs = static_cast<int64_t>(frame.timestampUs) - static_cast<int64_t>(firstTimestampUs);
+            if (elapsedUs < lastElapsedUs)
+            {
+                // 设备时钟回退（例如相机重连），以上一帧为基准重新对齐
+                elapsedUs = lastElapsedUs + 1000000 / std::max(config.targetFPS, 1);
+                firstTimestampUs = frame.timestampUs - static_cast<uint64_t>(elapsedUs);
+            }
+        }
+        else
+        {
+            // 时间戳按采集时刻计算，采集端抽帧或丢帧时播放速度仍然正确
+            elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(frame.captureTime - epoch).count();
+        }
+        lastElapsedUs = elapsedUs;
+
+        int64_t pts = std::max(nextPts, av_rescale_q(elapsedUs, AVRational{1, 1000000}, timeBase));
+        nextPts = pts + 1;
+        ptsTimes[pts] = PendingFrame{frame.captureTime, frame.motion};
+        return pts;
+    }
+
+    void EncodingSession::flush()
+    {
+        if (encoder)
+        {
+            encoder->flush([this](AVPacket *pkt)
+                           { handlePacket(pkt); });
+        }
+        closeSegment();
+    }
+
+    bool EncodingSession::segmentTargetReached() const
+    {
+        int64_t durationMs = av_rescale_q(nextPts - segmentStartPts, timeBase, AVRational{1, 1000});
+        return durationMs >= config.segmentTargetMs || current.bytes >= config.segmentTargetBytes;
+    }
+
+    void EncodingSession::handlePacket(AVPacket *packet)
+    {
+        bool keyframe = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+        if (keyframe && (!muxer || cutPending))
+        {
+            closeSegment();
+            openSegment();
+            segmentStartPts = packet->pts;
+            cutPending = false;
+        }
+        // 查找该数据包对应的采集时刻（B帧时数据包按解码顺序输出，需按pts查找）
+        std::chrono::system_clock::time_point captureTime;
+        float motion = -1.0f;
+        bool known = false;
+        auto it = ptsTimes.find(packet->pts);
+        if (it != ptsTimes.end())
+        {
+            captureTime = it->second.captureTime;
+            motion = it->second.motion;
+            known = true;
+            ptsTimes.erase(it);
+        }
+
+        if (!muxer)
+            return; // 第一个关键帧之前的数据包无法独立解码，丢弃
+
+        // 记录分段的起止采集时刻和活动信息
+        if (known)
+        {
+            if (current.frameCount == 0 || captureTime < current.startTime)
+                current.startTime = captureTime;
+            if (captureTime > current.endTime)
+                current.endTime = captureTime;
+            current.recordMotion(motion, config.motionThreshold);
+        }
+        // 记录关键帧索引：先冲刷封装器缓存的数据（MP4分片、MKV簇、TS的PES），该关键帧的数据从当前偏移开始
+        if (keyframe && known &&
+            (current.keyframes.empty() || captureTime - current.keyframes.back().time >= kIndexInterval))
+        {
+            av_write_frame(muxer, nullptr);
+            current.keyframes.push_back(KeyframeEntry{static_cast<uint64_t>(avio_tell(muxer->pb)), captureTime});
+        }
+
+        current.frameCount++;
+        current.bytes += packet->size;
+
+        if (liveOutput)
+            liveOutput->push(packet); // 复制后交给发送线程，时间戳仍为timeBase单位
+
+        av_packet_rescale_ts(packet, timeBase, stream->time_base);
+        packet->stream_index = stream->index;
+        int ret = av_write_frame(muxer, packet);
+        if (ret < 0)
+        {
+            std::cerr << "[EncodingSession] 写入分段失败: " << current.path << std::endl;
+        }
+    }
+
+    void EncodingSession::openSegment()
+    {
+        const bool mp4 = container == SegmentContainer::FragmentedMp4;
+        current = Segment();
+        current.extension = containerExtension(container);
+
+        char path[256];
+        snprintf(path, sizeof(path), "%sseg_%s%s%ld%s", config.tempDir.c_str(),
+                 renditionName.c_str(), renditionName.empty() ? "" : "_",
+                 static_cast<long>(std::chrono::high_resolution_clock::now().time_since_epoch().count()),
+                 current.extension.c_str());
+        current.path = path;
+
+        avformat_alloc_output_context2(&muxer, nullptr, containerFormat(container), current.path.c_str());
+        if (!muxer)
+        {
+            throw std::runtime_error("[EncodingSession] 封装器创建失败");
+        }
+
+        stream = avformat_new_stream(muxer, nullptr);
+        if (encoder)
+        {
+            avcodec_parameters_from_context(stream->codecpar, encoder->context());
+        }
+        else
+        {
+            stream->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+            stream->codecpar->codec_id = AV_CODEC_ID_MJPEG;
+            stream->codecpar->width = passthroughWidth;
+            stream->codecpar->height = passthroughHeight;
+            stream->avg_frame_rate = AVRational{config.targetFPS, 1};
+        }
+        stream->time_base = timeBase;
+        if (liveOutput)
+            liveOutput->setStream(stream->codecpar, timeBase);
+
+        AVDictionary *opts = nullptr;
+        if (mp4 && encoder)
+        {
+            // 分片MP4：moov在文件头，每个关键帧开始一个新分片，可边写边读
+            av_dict_set(&opts, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+        }
+        else if (mp4)
+        {
+            // 直通模式每帧都是关键帧，按时长分片，避免每帧一个moof
+            av_dict_set(&opts, "movflags", "empty_moov+default_base_moof", 0);
+            av_dict_set(&opts, "frag_duration", "1000000", 0);
+        }
+
+        int ret = 0;
+        if (config.inMemorySegments)
+        {
+            // 输出到内存缓冲，上传时直接使用，不经过磁盘
+            output.data = std::make_shared<std::vector<uint8_t>>();
+            output.data->reserve(config.segmentTargetBytes);
+            output.position = 0;
+            auto ioBuffer = static_cast<unsigned char *>(av_malloc(kIoBufferSize));
+            muxer->pb = avio_alloc_context(ioBuffer, kIoBufferSize, 1, &output, nullptr, writeToBuffer, seekInBuffer);
+            muxer->flags |= AVFMT_FLAG_CUSTOM_IO;
+            if (!muxer->pb)
+            {
+                av_free(ioBuffer);
+                ret = AVERROR(ENOMEM);
+            }
+        }
+        else
+        {
+            ret = avio_open(&muxer->pb, current.path.c_str(), AVIO_FLAG_WRITE);
+        }
+        if (ret >= 0)
+            ret = avformat_write_header(muxer, &opts);
+        av_dict_free(&opts);
+        if (ret < 0)
+        {
+            closeOutput();
+            throw std::runtime_error("[EncodingSession] 分段文件打开失败: " + current.path);
+        }
+        current.headerBytes = static_cast<uint64_t>(avio_tell(muxer->pb));
+    }
+
+    void EncodingSession::closeOutput()
+    {
+        if (muxer->flags & AVFMT_FLAG_CUSTOM_IO)
+        {
+            if (muxer->pb)
+            {
+                avio_flush(muxer->pb);
+                av_freep(&muxer->pb->buffer);
+            }
+            avio_context_free(&muxer->pb);
+        }
+        else
+        {
+            avio_closep(&muxer->pb);
+        }
+        avformat_free_context(muxer);
+        muxer = nullptr;
+        stream = nullptr;
+    }
+
+    void EncodingSession::closeSegment()
+    {
+        if (!muxer)
+            return;
+
+        av_write_trailer(muxer);
+        closeOutput();
+
+        if (output.data)
+        {
+            current.bytes = output.data->size();
+            current.data = std::move(output.data);
+            output = MemoryOutput();
+        }
+        else
+        {
+            struct stat statBuf;
+            if (stat(current.path.c_str(), &statBuf) == 0)
+                current.bytes = statBuf.st_size;
+        }
+
+        std::cout << "[EncodingSession] 分段完成: " << current.path << "，" << current.frameCount
+                  << " 帧，" << current.bytes << " 字节" << std::endl;
+        if (onSegment)
+            onSegment(current);
+        current = Segment();
+    }
+} // namespace VideoStreamer
@@ -0,0 +1,162 @@
+#pragma once
+#include "config.hpp"
+#include "frame.hpp"
+#include "segment.hpp"
+#include "libav_encoder.hpp"
+#include "live_output.hpp"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+namespace VideoStreamer
+{
+    /**
+     * 封装器的内存输出：写入位置可以回退，封装器结束时可回写文件头（AVI索引、MKV时长等）
+     */
+    struct MemoryOutput
+    {
+        std::shared_ptr<std::vector<uint8_t>> data; // 输出缓冲
+        size_t position = 0;                        // 当前写入位置
+    };
+
+    /**
+     * EncodingSession类，长期存在的连续编码会话
+     * 帧被持续送入同一个H.264编码器（码率控制不会在分段边界重置），
+     * 输出在达到时长/大小目标后于关键帧处切分，封装为MPEG-TS、分片MP4、MKV或AVI分段
+     * 直通模式（EncoderBackend::Passthrough）下不创建编码器，相机的JPEG数据按设备时间戳直接封装，
+     * 每一帧都是关键帧，可在任意帧处切分
+     * 配置了liveOutputUrl时，写入分段的数据包同时交给LiveOutput实时发送
+     * 编码阶梯的每个档位各有一个会话（尺寸、码率取自rendition），同一摄像头的会话共享一个PictureLadder，每帧只解码一次
+     */
+    class EncodingSession
+    {
+    public:
+        // 分段完成时的回调
+        using SegmentHandler = std::function<void(const Segment &)>;
+
+        EncodingSession(const AppConfig &cfg, SegmentHandler handler, const Rendition &rendition = Rendition());
+        ~EncodingSession();
+
+        EncodingSession(const EncodingSession &) = delete;
+        EncodingSession &operator=(const EncodingSession &) = delete;
+
+        /**
+         * 送入一帧进行编码，可能触发分段输出
+         */
+        void push(const FramePtr &frame);
+
+        /**
+         * 送入一帧进行编码，编码输入取自已load该帧的共享PictureLadder（编码阶梯使用），可能触发分段输出
+         */
+        void push(const FramePtr &frame, PictureLadder &pictures);
+
+        /**
+         * 调整编码码率，下一帧起生效
+         */
+        void setBitRate(int64_t bitRate)
+        {
+            if (encoder)
+                encoder->setBitRate(bitRate);
+        }
+
+        /**
+         * 冲刷编码器并关闭当前分段
+         */
+        void flush();
+
+        /**
+         * 实时输出（未启用时为nullptr）
+         */
+        const LiveOutput *live() const { return liveOutput.get(); }
+
+    private:
+        /**
+         * 编码encoder已准备好的一帧，必要时请求在该帧处切分
+         */
+        void encodePrepared(const Frame &frame);
+
+        /**
+         * 直通模式：把一帧JPEG数据作为数据包直接送入封装器
+         */
+        void pushPassthrough(const FramePtr &frame);
+
+        /**
+         * 计算帧的时间戳（timeBase单位，有设备时间戳时按设备时钟，否则按采集时刻）并记录采集时刻，保证单调递增
+         */
+        int64_t assignPts(const Frame &frame);
+
+        /**
+         * 处理编码器输出的数据包：必要时切分分段，然后写入封装器
+         */
+        void handlePacket(AVPacket *packet);
+
+        /**
+         * 打开一个新的分段文件
+         */
+        void openSegment();
+
+        /**
+         * 关闭当前分段并通过回调交付
+         */
+        void closeSegment();
+
+        /**
+         * 关闭并释放封装器的输出（文件或内存）
+         */
+        void closeOutput();
+
+        /**
+         * 当前分段是否已达到切分目标
+         */
+        bool segmentTargetReached() const;
+
+        // 配置参数
+        AppConfig config;
+
+        // 分段完成回调
+        SegmentHandler onSegment;
+
+        // 档位名称（同一摄像头有多个档位时用于区分本地分段文件名）
+        std::string renditionName;
+
+        // 编码器（会话期间保持不变，直通模式下为空）
+        std::unique_ptr<LibavEncoder> encoder;
+
+        // 实时输出（配置了liveOutputUrl时创建）
+        std::unique_ptr<LiveOutput> liveOutput;
+
+        AVRational timeBase;               // 数据包时间戳的单位：编码时为1/帧率，直通时为微秒
+        SegmentContainer container;        // 实际使用的封装格式
+        AVPacket *passthroughPacket = nullptr; // 直通模式复用的数据包（不持有数据）
+        int passthroughWidth = 0;          // 直通模式的图像尺寸（来自第一帧）
+        int passthroughHeight = 0;
+        uint64_t firstTimestampUs = 0;     // 直通模式第一帧的设备时间戳
+        int64_t lastElapsedUs = 0;         // 上一帧相对会话起点的时间（微秒）
+
+        AVFormatContext *muxer = nullptr;  // 当前分段的封装器
+        AVStream *stream = nullptr;        // 视频流
+        Segment current;                   // 当前分段信息
+        MemoryOutput output;               // 内存分段的输出（inMemorySegments时使用）
+        int64_t segmentStartPts = 0;       // 当前分段第一帧的时间戳
+        int64_t nextPts = 0;               // 下一帧允许的最小时间戳
+        bool hasEpoch = false;             // 是否已记录会话起点
+        std::chrono::system_clock::time_point epoch; // 会话起点（第一帧的采集时刻）
+        bool cutPending = false;           // 已请求在下一个关键帧处切分
+
+        // 已送入编码器的帧的信息（编码输出的数据包按pts查找）
+        struct PendingFrame
+        {
+            std::chrono::system_clock::time_point captureTime; // 采集时刻，用于记录分段的起止时间
+            float motion;                                      // 运动分析结果，累计到分段的活动信息
+        };
+        std::map<int64_t, PendingFrame> ptsTimes;
+    };
+} // namespace VideoStreamer
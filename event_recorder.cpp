@@ -0,0 +1,194 @@
+#include "event_recorder.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace VideoStreamer
+{
+    namespace
+    {
+        int64_t toMicros(std::chrono::system_clock::time_point t)
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+        }
+    } // namespace
+
+    EventRecorder::EventRecorder(const AppConfig &cfg)
+        : config(cfg),
+          pool(BufferPool::create(static_cast<size_t>(std::max(cfg.preRollMs, 0)) * std::max(cfg.targetFPS, 1) / 1000 + 2))
+    {
+    }
+
+    void EventRecorder::trigger(std::chrono::system_clock::time_point at)
+    {
+        int64_t until = toMicros(at + std::chrono::milliseconds(config.postRollMs));
+        int64_t current = recordUntilUs.load();
+        while (current < until && !recordUntilUs.compare_exchange_weak(current, until))
+        {
+        }
+    }
+
+    bool EventRecorder::admit(const FramePtr &frame, std::vector<FramePtr> &out)
+    {
+        if (toMicros(frame->captureTime) <= recordUntilUs.load())
+        {
+            if (!inEvent)
+            {
+                inEvent = true;
+                isRecording = true;
+                ++eventCount;
+            }
+            // 先交出触发前的画面，再交出当前帧
+            out.insert(out.end(), window.begin(), window.end());
+            out.push_back(frame);
+            window.clear();
+            bytes = 0;
+            frameCount = 0;
+            byteCount = 0;
+            return false;
+        }
+
+        bool ended = inEvent;
+        inEvent = false;
+        isRecording = false;
+
+        if (frame->sdkFrame)
+            copyToPool(*frame);
+        window.push_back(frame);
+        bytes += frame->dataSize();
+        trim(frame->captureTime);
+        frameCount = window.size();
+        byteCount = bytes;
+        return ended;
+    }
+
+    void EventRecorder::copyToPool(Frame &frame)
+    {
+        auto buffer = pool->acquire(frame.dataSize());
+        std::memcpy(buffer->data(), frame.data(), frame.dataSize());
+        frame.payload = buffer;
+        frame.sdkFrame.reset();
+    }
+
+    void EventRecorder::trim(std::chrono::system_clock::time_point newest)
+    {
+        const auto preRoll = std::chrono::milliseconds(config.preRollMs);
+        while (!window.empty())
+        {
+            const Frame &oldest = *window.front();
+            bool tooOld = newest - oldest.captureTime > preRoll;
+            bool tooLarge = bytes > config.preRollMaxBytes && window.size() > 1;
+            if (!tooOld && !tooLarge)
+                break;
+            bytes -= oldest.dataSize();
+            window.pop_front();
+        }
+    }
+
+    EventTriggerServer::EventTriggerServer(const AppConfig &cfg, TriggerHandler handler)
+        : config(cfg), onTrigger(std::move(handler))
+    {
+    }
+
+    EventTriggerServer::~EventTriggerServer()
+    {
+        stop();
+    }
+
+    void EventTriggerServer::start()
+    {
+        if (config.eventSocketPath.empty())
+            return;
+
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (config.eventSocketPath.size() >= sizeof(addr.sun_path))
+        {
+            std::cerr << "[EventTriggerServer] 套接字路径过长: " << config.eventSocketPath << std::endl;
+            return;
+        }
+        strncpy(addr.sun_path, config.eventSocketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0)
+        {
+            std::cerr << "[EventTriggerServer] 套接字创建失败: " << strerror(errno) << std::endl;
+            return;
+        }
+        unlink(config.eventSocketPath.c_str()); // 删除上次运行遗留的套接字文件
+        if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(listenFd, 4) != 0)
+        {
+            std::cerr << "[EventTriggerServer] 监听失败: " << config.eventSocketPath << ": " << strerror(errno) << std::endl;
+            close(listenFd);
+            listenFd = -1;
+            return;
+        }
+        std::cout << "[EventTriggerServer] 触发套接字: " << config.eventSocketPath << std::endl;
+
+        running = true;
+        thread = std::thread(&EventTriggerServer::run, this);
+    }
+
+    void EventTriggerServer::stop()
+    {
+        if (!running.exchange(false))
+            return;
+        if (thread.joinable())
+            thread.join();
+        close(listenFd);
+        listenFd = -1;
+        unlink(config.eventSocketPath.c_str());
+    }
+
+    void EventTriggerServer::run()
+    {
+        while (running)
+        {
+            // 等待连接，超时后回到循环检查running
+            pollfd pfd{listenFd, POLLIN, 0};
+            if (poll(&pfd, 1, 200) > 0 && (pfd.revents & POLLIN))
+            {
+                int fd = accept(listenFd, nullptr, nullptr);
+                if (fd >= 0)
+                    serveClient(fd);
+            }
+        }
+    }
+
+    void EventTriggerServer::serveClient(int fd)
+    {
+        // 读取一行命令
+        std::string line;
+        char buffer[256];
+        pollfd pfd{fd, POLLIN, 0};
+        while (line.find('\n') == std::string::npos && line.size() < 1024 && poll(&pfd, 1, 1000) > 0)
+        {
+            ssize_t n = read(fd, buffer, sizeof(buffer));
+            if (n <= 0)
+                break;
+            line.append(buffer, static_cast<size_t>(n));
+        }
+
+        std::istringstream in(line);
+        std::string command, camera;
+        in >> command >> camera;
+
+        std::string reply;
+        if (command != "trigger")
+            reply = "error unknown command\n";
+        else if (!onTrigger(camera))
+            reply = "error unknown camera\n";
+        else
+            reply = "ok\n";
+        ssize_t ignored = send(fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+        (void)ignored;
+        close(fd);
+    }
+} // namespace VideoStreamer
@@ -0,0 +1,129 @@
+#pragma once
+#include "config.hpp"
+#include "frame.hpp"
+#include "buffer_pool.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace VideoStreamer
+{
+    /**
+     * EventRecorder类，事件录制的前置历史窗口
+     * 空闲时帧只保存在内存中，按preRollMs和preRollMaxBytes淘汰最旧的帧，不进入编码和上传；
+     * 触发后历史窗口中的帧和postRollMs内的新帧依次交给帧缓冲区编码
+     * admit只由帧存储线程调用，trigger可在任意线程调用
+     */
+    class EventRecorder
+    {
+    public:
+        explicit EventRecorder(const AppConfig &cfg);
+
+        /**
+         * 触发一次事件，录制到at之后postRollMs；录制期间再次触发会延长录制
+         */
+        void trigger(std::chrono::system_clock::time_point at);
+
+        /**
+         * 处理一帧：空闲时存入历史窗口，out不变；录制中把历史窗口中的帧和该帧依次追加到out
+         * 返回true表示一次事件的录制刚刚结束（该帧已不属于事件）
+         */
+        bool admit(const FramePtr &frame, std::vector<FramePtr> &out);
+
+        /**
+         * 是否正在录制事件
+         */
+        bool recording() const { return isRecording; }
+
+        /**
+         * 历史窗口中的帧数和内存字节数（指标线程读取）
+         */
+        size_t windowFrames() const { return frameCount; }
+        size_t windowBytes() const { return byteCount; }
+
+        /**
+         * 已开始录制的事件数（录制期间的重复触发不计入）
+         */
+        uint64_t events() const { return eventCount; }
+
+    private:
+        /**
+         * 将SDK帧复制到池化缓冲区，历史窗口不长期占用SDK的帧缓冲
+         */
+        void copyToPool(Frame &frame);
+
+        /**
+         * 淘汰超出时长或字节上限的最旧帧
+         */
+        void trim(std::chrono::system_clock::time_point newest);
+
+        // 配置参数
+        AppConfig config;
+
+        // 帧数据缓冲池
+        std::shared_ptr<BufferPool> pool;
+
+        std::deque<FramePtr> window;  // 历史窗口（仅帧存储线程访问）
+        size_t bytes = 0;             // 历史窗口的字节数
+        bool inEvent = false;         // 帧存储线程看到的录制状态
+
+        std::atomic<int64_t> recordUntilUs{INT64_MIN}; // 录制截止的采集时刻（系统时钟微秒）
+        std::atomic<bool> isRecording{false};
+        std::atomic<size_t> frameCount{0};
+        std::atomic<size_t> byteCount{0};
+        std::atomic<uint64_t> eventCount{0};
+    };
+
+    /**
+     * EventTriggerServer类，在本地Unix套接字上接收触发命令
+     * 每个连接发送一行："trigger" 触发所有摄像头，"trigger <序列号>" 只触发指定摄像头，
+     * 回复 "ok" 或 "error <原因>"，例如：echo trigger | nc -U /run/videostreamer.sock
+     */
+    class EventTriggerServer
+    {
+    public:
+        // 触发回调，参数为摄像头序列号（为空表示所有摄像头），找到摄像头时返回true
+        using TriggerHandler = std::function<bool(const std::string &)>;
+
+        EventTriggerServer(const AppConfig &cfg, TriggerHandler handler);
+        ~EventTriggerServer();
+
+        EventTriggerServer(const EventTriggerServer &) = delete;
+        EventTriggerServer &operator=(const EventTriggerServer &) = delete;
+
+        /**
+         * 启动监听线程（未配置eventSocketPath时不启动）
+         */
+        void start();
+
+        /**
+         * 停止监听线程并删除套接字文件
+         */
+        void stop();
+
+    private:
+        /**
+         * 监听线程主循环
+         */
+        void run();
+
+        /**
+         * 处理一个连接
+         */
+        void serveClient(int fd);
+
+        // 配置参数
+        AppConfig config;
+        TriggerHandler onTrigger;
+
+        std::atomic<bool> running{false};
+        std::thread thread;
+        int listenFd = -1;
+    };
+} // namespace VideoStreamer
@@ -0,0 +1,54 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <libobsensor/ObSensor.hpp>
+
+namespace VideoStreamer
+{
+    /**
+     * Frame结构体，表示一帧图像数据，与数据来源（摄像头/回放/合成）无关
+     */
+    struct Frame
+    {
+        // 帧数据（回放/合成源使用，可在多帧之间共享）
+        std::shared_ptr<const std::vector<uint8_t>> payload;
+
+        // SDK帧对象（摄像头源使用，直接引用SDK缓冲区避免拷贝）
+        std::shared_ptr<ob::ColorFrame> sdkFrame;
+
+        uint32_t width = 0;                   // 图像宽度
+        uint32_t height = 0;                  // 图像高度
+        ob_format format = OB_FORMAT_MJPG;    // 图像格式
+        uint64_t index = 0;                   // 帧序号
+        uint64_t timestampUs = 0;             // 设备时间戳（微秒）
+        bool hardwareTimestamp = false;       // timestampUs来自设备硬件时钟（编码时直接用作pts）
+        std::chrono::system_clock::time_point captureTime; // 采集时刻（系统时钟）
+        float motion = -1.0f;                 // 与上一帧相比变化像素的比例（0~1），小于0表示未分析
+        std::string filePath;                 // 磁盘副本路径（写入tempDir后设置）
+
+        /**
+         * 获取帧数据指针
+         */
+        const uint8_t *data() const
+        {
+            if (sdkFrame)
+                return static_cast<const uint8_t *>(sdkFrame->data());
+            return payload ? payload->data() : nullptr;
+        }
+
+        /**
+         * 获取帧数据大小（字节）
+         */
+        size_t dataSize() const
+        {
+            if (sdkFrame)
+                return sdkFrame->dataSize();
+            return payload ? payload->size() : 0;
+        }
+    };
+
+    using FramePtr = std::shared_ptr<Frame>;
+} // namespace VideoStreamer
@@ -0,0 +1,399 @@
+#include "frame_source.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <opencv2/opencv.hpp>
+
+namespace VideoStreamer
+{
+    FramePacer::FramePacer(int fps, bool freeRun)
+        : interval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              std::chrono::duration<double>(1.0 / std::max(fps, 1)))),
+          freeRun(freeRun) {}
+
+    void FramePacer::wait()
+    {
+        if (freeRun)
+            return;
+
+        auto now = std::chrono::steady_clock::now();
+        if (!started)
+        {
+            started = true;
+            next = now;
+        }
+        if (next > now)
+        {
+            std::this_thread::sleep_until(next);
+        }
+        else if (now - next > interval * 4)
+        {
+            next = now; // 落后太多时重新对齐，避免补帧突发
+        }
+        next += interval;
+    }
+
+    // ---------------------------- OrbbecFrameSource ----------------------------
+
+    namespace
+    {
+        // 设备时间戳换算的采集时刻落后当前时刻超过该值时重新对齐（例如相机重连、时钟漂移）
+        const int64_t kClockResyncUs = 1000000;
+
+        int64_t nowMicros()
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                .count();
+        }
+    } // namespace
+
+    OrbbecFrameSource::OrbbecFrameSource(const AppConfig &cfg) : config(cfg)
+    {
+        if (config.cameraSerial.empty())
+        {
+            pipeline.reset(new ob::Pipeline()); // 使用第一个设备
+        }
+        else
+        {
+            // 按序列号从设备列表中选择摄像头
+            ob::Context context;
+            auto devices = context.queryDeviceList();
+            std::shared_ptr<ob::Device> device;
+            for (uint32_t i = 0; i < devices->deviceCount() && !device; ++i)
+            {
+                if (config.cameraSerial == devices->serialNumber(i))
+                    device = devices->getDevice(i);
+            }
+            if (!device)
+            {
+                throw std::runtime_error("[OrbbecFrameSource] 未找到序列号为 " + config.cameraSerial + " 的摄像头");
+            }
+            pipeline.reset(new ob::Pipeline(device));
+        }
+
+        auto profiles = pipeline->getStreamProfileList(OB_SENSOR_COLOR);
+
+        auto profile = profiles->getVideoStreamProfile(
+            config.targetWidth,
+            config.targetHeight,
+            config.colorFormat,
+            config.targetFPS);
+
+        obConfig = std::make_shared<ob::Config>();
+        obConfig->enableStream(profile);
+
+        // 轮询模式直接启动数据流管道；回调模式等待start()注册回调后再启动
+        if (config.captureMode == CaptureMode::Polling)
+        {
+            pipeline->start(obConfig);
+            started = true;
+        }
+    }
+
+    FramePtr OrbbecFrameSource::getFrame(int timeoutMs)
+    {
+        if (!started)
+        {
+            // 回调模式下没有调用start()，退回轮询
+            pipeline->start(obConfig);
+            started = true;
+        }
+
+        auto frameSet = pipeline->waitForFrames(timeoutMs);
+        if (!frameSet || !frameSet->colorFrame())
+            return nullptr;
+        return makeFrame(frameSet->colorFrame());
+    }
+
+    bool OrbbecFrameSource::start(FrameCallback callback)
+    {
+        if (config.captureMode != CaptureMode::Callback || started)
+            return false;
+
+        // 回调在SDK的线程上执行，帧到达后立即交出，不经过waitForFrames的内部队列
+        pipeline->start(obConfig, [this, callback](std::shared_ptr<ob::FrameSet> frameSet)
+                        {
+                            if (!frameSet || !frameSet->colorFrame())
+                                return;
+                            callback(makeFrame(frameSet->colorFrame()));
+                        });
+        started = true;
+        return true;
+    }
+
+    void OrbbecFrameSource::stop()
+    {
+        if (!started)
+            return;
+        pipeline->stop(); // 停止流（回调模式下返回后不再有回调）
+        started = false;
+    }
+
+    FramePtr OrbbecFrameSource::makeFrame(std::shared_ptr<ob::ColorFrame> colorFrame)
+    {
+        auto frame = std::make_shared<Frame>();
+        frame->sdkFrame = colorFrame;
+        frame->width = colorFrame->width();
+        frame->height = colorFrame->height();
+        frame->format = colorFrame->format();
+        frame->index = colorFrame->index();
+        frame->timestampUs = colorFrame->timeStampUs();
+        frame->hardwareTimestamp = frame->timestampUs != 0;
+
+        // 设备帧号不连续说明中间的帧在设备、USB或SDK队列中丢失；帧号回退表示数据流重新开始
+        if (hasIndex && frame->index > lastIndex + 1)
+        {
+            uint64_t lost = frame->index - lastIndex - 1;
+            dropped += lost;
+            std::cerr << "[OrbbecFrameSource] 丢失 " << lost << " 帧（帧号 " << lastIndex + 1 << " ~ " << frame->index - 1
+                      << "）" << std::endl;
+        }
+        hasIndex = true;
+        lastIndex = frame->index;
+
+        // 采集时刻 = 设备时间戳 + 偏移：帧间隔取自设备时钟，不受回调或轮询延迟的抖动影响
+        const int64_t now = nowMicros();
+        if (!frame->hardwareTimestamp)
+        {
+            frame->captureTime = std::chrono::system_clock::time_point(std::chrono::microseconds(now));
+            return frame;
+        }
+        const int64_t timestamp = static_cast<int64_t>(frame->timestampUs);
+        const int64_t lag = now - (timestamp + clockOffsetUs);
+        if (!hasClock || frame->timestampUs < lastTimestampUs || lag > kClockResyncUs)
+            clockOffsetUs = now - timestamp;
+        else if (lag < 0)
+            clockOffsetUs += lag; // 设备时钟偏快，保证采集时刻不晚于到达时刻
+        hasClock = true;
+        lastTimestampUs = frame->timestampUs;
+        frame->captureTime = std::chrono::system_clock::time_point(std::chrono::microseconds(timestamp + clockOffsetUs));
+        return frame;
+    }
+
+    // ---------------------------- ReplayFrameSource ----------------------------
+
+    ReplayFrameSource::ReplayFrameSource(const AppConfig &cfg)
+        : config(cfg), pacer(cfg.targetFPS, cfg.freeRun)
+    {
+        if (config.colorFormat != OB_FORMAT_MJPG)
+        {
+            throw std::runtime_error("[ReplayFrameSource] 仅支持MJPEG格式回放");
+        }
+        load();
+        resizeFrames();
+        std::cout << "[ReplayFrameSource] 已加载 " << frames.size() << " 帧: " << config.replayPath << std::endl;
+    }
+
+    void ReplayFrameSource::load()
+    {
+        auto readFile = [](const std::string &path)
+        {
+            std::ifstream in(path, std::ios::binary);
+            if (!in.is_open())
+            {
+                throw std::runtime_error("[ReplayFrameSource] 文件打开失败: " + path);
+            }
+            return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        };
+
+        struct stat statBuf;
+        if (stat(config.replayPath.c_str(), &statBuf) != 0)
+        {
+            throw std::runtime_error("[ReplayFrameSource] 回放路径不存在: " + config.replayPath);
+        }
+
+        if (S_ISDIR(statBuf.st_mode))
+        {
+            // 目录模式：按文件名排序读取所有.jpg文件
+            std::vector<std::string> names;
+            if (DIR *dir = opendir(config.replayPath.c_str()))
+            {
+                while (auto *entry = readdir(dir))
+                {
+                    std::string name = entry->d_name;
+                    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".jpg") == 0)
+                        names.push_back(name);
+                }
+                closedir(dir);
+            }
+            std::sort(names.begin(), names.end());
+
+            std::string dirPath = config.replayPath;
+            if (dirPath.back() != '/')
+                dirPath += '/';
+            for (const auto &name : names)
+            {
+                frames.push_back(std::make_shared<const std::vector<uint8_t>>(readFile(dirPath + name)));
+            }
+        }
+        else
+        {
+            // 文件模式：按SOI(FFD8)/EOI(FFD9)标记切分MJPEG流
+            auto data = readFile(config.replayPath);
+            size_t pos = 0;
+            while (pos + 1 < data.size())
+            {
+                size_t soi = pos;
+                while (soi + 1 < data.size() && !(data[soi] == 0xFF && data[soi + 1] == 0xD8))
+                    ++soi;
+                size_t eoi = soi + 2;
+                while (eoi + 1 < data.size() && !(data[eoi] == 0xFF && data[eoi + 1] == 0xD9))
+                    ++eoi;
+                if (eoi + 1 >= data.size())
+                    break;
+
+                frames.push_back(std::make_shared<const std::vector<uint8_t>>(
+                    data.begin() + soi, data.begin() + eoi + 2));
+                pos = eoi + 2;
+            }
+        }
+
+        if (frames.empty())
+        {
+            throw std::runtime_error("[ReplayFrameSource] 未找到可回放的JPEG帧: " + config.replayPath);
+        }
+    }
+
+    void ReplayFrameSource::resizeFrames()
+    {
+        // 缩放在加载阶段一次性完成，回放时不产生额外开销；无法解码的帧（损坏的JPEG）跳过
+        std::vector<std::shared_ptr<const std::vector<uint8_t>>> usable;
+        usable.reserve(frames.size());
+        size_t skipped = 0;
+        bool resizing = false;
+        for (auto &jpeg : frames)
+        {
+            cv::Mat image = cv::imdecode(cv::Mat(*jpeg), cv::IMREAD_COLOR);
+            if (image.empty())
+            {
+                ++skipped;
+                continue;
+            }
+            if (image.cols != config.targetWidth || image.rows != config.targetHeight)
+            {
+                if (!resizing)
+                {
+                    std::cout << "[ReplayFrameSource] 缩放回放帧 " << image.cols << "x" << image.rows
+                              << " -> " << config.targetWidth << "x" << config.targetHeight << std::endl;
+                    resizing = true;
+                }
+                cv::Mat scaled;
+                cv::resize(image, scaled, cv::Size(config.targetWidth, config.targetHeight), 0, 0, cv::INTER_AREA);
+                std::vector<uint8_t> encoded;
+                cv::imencode(".jpg", scaled, encoded, {cv::IMWRITE_JPEG_QUALITY, 90});
+                jpeg = std::make_shared<const std::vector<uint8_t>>(std::move(encoded));
+            }
+            usable.push_back(std::move(jpeg));
+        }
+        frames.swap(usable);
+
+        if (skipped > 0)
+        {
+            std::cerr << "[ReplayFrameSource] 跳过 " << skipped << " 个无法解码的JPEG帧" << std::endl;
+        }
+        if (frames.empty())
+        {
+            throw std::runtime_error("[ReplayFrameSource] 没有可解码的JPEG帧: " + config.replayPath);
+        }
+    }
+
+    FramePtr ReplayFrameSource::getFrame(int timeoutMs)
+    {
+        if (cursor >= frames.size())
+        {
+            if (!config.replayLoop)
+            {
+                // 回放结束，模拟摄像头超时
+                std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+                return nullptr;
+            }
+            cursor = 0;
+        }
+
+        pacer.wait();
+
+        auto frame = std::make_shared<Frame>();
+        frame->payload = frames[cursor++];
+        frame->width = config.targetWidth;
+        frame->height = config.targetHeight;
+        frame->format = OB_FORMAT_MJPG;
+        frame->index = frameIndex++;
+        frame->captureTime = std::chrono::system_clock::now();
+        frame->timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::steady_clock::now().time_since_epoch())
+                                 .count();
+        return frame;
+    }
+
+    // --------------------------- SyntheticFrameSource --------------------------
+
+    SyntheticFrameSource::SyntheticFrameSource(const AppConfig &cfg)
+        : config(cfg), pacer(cfg.targetFPS, cfg.freeRun)
+    {
+        if (config.colorFormat != OB_FORMAT_MJPG)
+        {
+            throw std::runtime_error("[SyntheticFrameSource] 仅支持MJPEG格式");
+        }
+        generate();
+    }
+
+    void SyntheticFrameSource::generate()
+    {
+        const int count = std::max(config.syntheticFrameCount, 1);
+        const int barWidth = std::max(config.targetWidth / 16, 1);
+
+        for (int i = 0; i < count; ++i)
+        {
+            // 背景色随帧号变化，并叠加一条水平移动的竖条和帧号文字
+            cv::Mat image(config.targetHeight, config.targetWidth, CV_8UC3,
+                          cv::Scalar(40 + (i * 7) % 160, 80, 120));
+            int x = (config.targetWidth - barWidth) * i / count;
+            cv::rectangle(image, cv::Rect(x, 0, barWidth, config.targetHeight), cv::Scalar(255, 255, 255), -1);
+            cv::putText(image, "synthetic #" + std::to_string(i), cv::Point(20, 60),
+                        cv::FONT_HERSHEY_SIMPLEX, 1.5, cv::Scalar(0, 0, 0), 3);
+
+            std::vector<uint8_t> encoded;
+            cv::imencode(".jpg", image, encoded, {cv::IMWRITE_JPEG_QUALITY, 90});
+            frames.push_back(std::make_shared<const std::vector<uint8_t>>(std::move(encoded)));
+        }
+        std::cout << "[SyntheticFrameSource] 已生成 " << frames.size() << " 帧 "
+                  << config.targetWidth << "x" << config.targetHeight << std::endl;
+    }
+
+    FramePtr SyntheticFrameSource::getFrame(int)
+    {
+        pacer.wait();
+
+        auto frame = std::make_shared<Frame>();
+        frame->payload = frames[frameIndex % frames.size()];
+        frame->width = config.targetWidth;
+        frame->height = config.targetHeight;
+        frame->format = OB_FORMAT_MJPG;
+        frame->index = frameIndex++;
+        frame->captureTime = std::chrono::system_clock::now();
+        frame->timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::steady_clock::now().time_since_epoch())
+                                 .count();
+        return frame;
+    }
+
+    std::unique_ptr<FrameSource> createFrameSource(const AppConfig &cfg)
+    {
+        switch (cfg.frameSource)
+        {
+        case FrameSourceType::Replay:
+            return std::unique_ptr<FrameSource>(new ReplayFrameSource(cfg));
+        case FrameSourceType::Synthetic:
+            return std::unique_ptr<FrameSource>(new SyntheticFrameSource(cfg));
+        case FrameSourceType::Camera:
+        default:
+            return std::unique_ptr<FrameSource>(new OrbbecFrameSource(cfg));
+        }
+    }
+} // namespace VideoStreamer
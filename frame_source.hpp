@@ -0,0 +1,156 @@
+#pragma once
+#include "config.hpp"
+#include "frame.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <libobsensor/ObSensor.hpp>
+
+namespace VideoStreamer
+{
+    /**
+     * FrameSource接口，CameraCapture通过它获取视频帧，便于在无摄像头的主机上测试
+     */
+    class FrameSource
+    {
+    public:
+        // 回调方式采集时每帧调用一次（在数据源自己的线程上），不能阻塞
+        using FrameCallback = std::function<void(FramePtr)>;
+
+        virtual ~FrameSource() = default;
+
+        /**
+         * 获取一帧图像，超时或数据源结束时返回nullptr
+         */
+        virtual FramePtr getFrame(int timeoutMs) = 0;
+
+        /**
+         * 改为回调方式推送帧，数据源不支持时返回false（调用方继续轮询getFrame）
+         */
+        virtual bool start(FrameCallback) { return false; }
+
+        /**
+         * 停止数据源
+         */
+        virtual void stop() {}
+
+        /**
+         * 按设备帧号检测到的丢帧数（帧在到达本进程之前丢失）
+         */
+        virtual uint64_t droppedFrames() const { return 0; }
+    };
+
+    /**
+     * 按目标帧率节流的辅助类，freeRun为true时不做任何等待
+     */
+    class FramePacer
+    {
+    public:
+        FramePacer(int fps, bool freeRun);
+
+        /**
+         * 等待直到下一帧的发送时刻
+         */
+        void wait();
+
+    private:
+        std::chrono::steady_clock::duration interval;
+        std::chrono::steady_clock::time_point next;
+        bool freeRun;
+        bool started = false;
+    };
+
+    /**
+     * 基于Orbbec SDK的摄像头数据源
+     * 轮询模式下构造时启动数据流；回调模式下由start()以帧集回调启动，帧在SDK线程上直接交给调用方
+     * 两种模式都按设备帧号统计丢帧，并把设备时间戳换算为采集时刻，避免主机调度抖动影响时间轴
+     */
+    class OrbbecFrameSource : public FrameSource
+    {
+    public:
+        explicit OrbbecFrameSource(const AppConfig &cfg);
+        FramePtr getFrame(int timeoutMs) override;
+        bool start(FrameCallback callback) override;
+        void stop() override;
+        uint64_t droppedFrames() const override { return dropped; }
+
+    private:
+        /**
+         * 由SDK的彩色帧构造Frame：检查帧号连续性，按设备时间戳计算采集时刻
+         * 同一时刻只有一个线程调用（轮询线程或SDK回调线程）
+         */
+        FramePtr makeFrame(std::shared_ptr<ob::ColorFrame> colorFrame);
+
+        AppConfig config;
+        std::unique_ptr<ob::Pipeline> pipeline;
+        std::shared_ptr<ob::Config> obConfig;
+        bool started = false;
+
+        // 丢帧统计
+        bool hasIndex = false;
+        uint64_t lastIndex = 0;
+        std::atomic<uint64_t> dropped{0};
+
+        // 设备时钟到系统时钟的换算
+        bool hasClock = false;
+        int64_t clockOffsetUs = 0;   // 系统时钟（微秒） - 设备时间戳
+        uint64_t lastTimestampUs = 0;
+    };
+
+    /**
+     * 回放录制的MJPEG文件（JPEG帧首尾相接）或JPEG图片目录
+     */
+    class ReplayFrameSource : public FrameSource
+    {
+    public:
+        explicit ReplayFrameSource(const AppConfig &cfg);
+        FramePtr getFrame(int timeoutMs) override;
+
+    private:
+        /**
+         * 加载回放数据，按SOI/EOI标记切分出每一帧
+         */
+        void load();
+
+        /**
+         * 分辨率与配置不一致的帧预先缩放，无法解码的帧跳过；没有可解码的帧时抛出异常
+         */
+        void resizeFrames();
+
+        AppConfig config;
+        FramePacer pacer;
+        std::vector<std::shared_ptr<const std::vector<uint8_t>>> frames;
+        size_t cursor = 0;
+        uint64_t frameIndex = 0;
+    };
+
+    /**
+     * 合成数据源，预先生成一组带有运动图案的JPEG帧并循环输出
+     */
+    class SyntheticFrameSource : public FrameSource
+    {
+    public:
+        explicit SyntheticFrameSource(const AppConfig &cfg);
+        FramePtr getFrame(int timeoutMs) override;
+
+    private:
+        /**
+         * 生成图案帧并编码为JPEG
+         */
+        void generate();
+
+        AppConfig config;
+        FramePacer pacer;
+        std::vector<std::shared_ptr<const std::vector<uint8_t>>> frames;
+        uint64_t frameIndex = 0;
+    };
+
+    /**
+     * 根据配置创建对应的数据源
+     */
+    std::unique_ptr<FrameSource> createFrameSource(const AppConfig &cfg);
+} // namespace VideoStreamer
@@ -0,0 +1,342 @@
+#include "frame_store.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace VideoStreamer
+{
+    FrameStore::FrameStore(const AppConfig &cfg)
+        : config(cfg),
+          pool(BufferPool::create(std::max(cfg.maxQueueSize, 1) + cfg.h264GroupSize)),
+          ring(std::max(cfg.maxQueueSize, 1))
+    {
+        if (!config.tempDir.empty() && config.tempDir.back() != '/')
+        {
+            config.tempDir += '/';
+        }
+
+        // 确保tempDir存在（帧的磁盘副本和编码输出都写入该目录）
+        if (mkdir(config.tempDir.c_str(), 0755) != 0 && errno != EEXIST)
+        {
+            std::cerr << "[FrameStore] Failed to create directory: " << strerror(errno) << std::endl;
+        }
+    }
+
+    size_t FrameStore::push(const FramePtr &frame)
+    {
+        // 在锁外复制数据，尽快归还SDK缓冲
+        if (config.copyFrames && frame->sdkFrame)
+        {
+            copyToPool(*frame);
+        }
+
+        Entry entry;
+        entry.frame = frame;
+        entry.bytes = frame->dataSize();
+        entry.inMemory = true;
+
+        if (config.frameStorage == FrameStorage::Disk)
+        {
+            // 磁盘模式：每帧都写入tempDir
+            std::string path;
+            if (!writeFrame(*frame, path))
+            {
+                throw std::runtime_error("[FrameStore] 帧写入磁盘失败");
+            }
+            markSpilled(entry, path);
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        size_t dropped = 0;
+        if (count == ring.size())
+        {
+            dropOldest();
+            ++dropped;
+        }
+
+        ring[(head + count) % ring.size()] = entry;
+        ++count;
+        if (entry.inMemory)
+            bytesInMemory += entry.bytes;
+
+        // 超出字节上限：开启溢出时把最旧的内存帧写入磁盘，否则直接丢弃
+        while (count > 0 && bytesInMemory > config.maxQueueBytes + spillingBytes)
+        {
+            Entry *victim = nullptr;
+            if (config.spillToDisk)
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    Entry &candidate = ring[(head + i) % ring.size()];
+                    if (candidate.inMemory && !candidate.spilling)
+                    {
+                        victim = &candidate;
+                        break;
+                    }
+                }
+            }
+
+            if (victim)
+            {
+                // 在锁外写盘，编码线程的popBatch/waitForFrames不必等待磁盘I/O；
+                // 写盘期间帧仍在内存中，被取走或丢弃后写好的文件直接删除
+                FramePtr frame = victim->frame;
+                const size_t bytes = victim->bytes;
+                victim->spilling = true;
+                spillingBytes += bytes;
+                lock.unlock();
+                std::string path;
+                bool written = writeFrame(*frame, path);
+                lock.lock();
+                spillingBytes -= bytes;
+
+                Entry *entry = find(frame.get());
+                if (!entry)
+                {
+                    if (written)
+                        std::remove(path.c_str());
+                    continue;
+                }
+                entry->spilling = false;
+                if (written)
+                {
+                    markSpilled(*entry, path);
+                    bytesInMemory -= bytes;
+                    continue;
+                }
+            }
+            dropOldest();
+            ++dropped;
+        }
+        lock.unlock();
+        framesReady.notify_one();
+        return dropped;
+    }
+
+    bool FrameStore::waitForFrames(size_t minCount, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        framesReady.wait_for(lock, timeout, [&]
+                             { return count >= minCount || closed; });
+        return count >= minCount || (closed && count > 0);
+    }
+
+    bool FrameStore::drained() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return closed && count == 0;
+    }
+
+    void FrameStore::close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        framesReady.notify_all();
+    }
+
+    std::vector<FramePtr> FrameStore::popBatch(size_t maxCount, size_t &dropped)
+    {
+        dropped = 0;
+        std::vector<FramePtr> batch;
+        std::vector<bool> spilled;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            size_t n = std::min(maxCount, count);
+            batch.reserve(n);
+            for (size_t i = 0; i < n; ++i)
+            {
+                Entry &entry = ring[head];
+                if (entry.inMemory)
+                    bytesInMemory -= entry.bytes;
+                batch.push_back(std::move(entry.frame));
+                spilled.push_back(!entry.inMemory);
+                entry = Entry();
+                head = (head + 1) % ring.size();
+                --count;
+            }
+        }
+
+        // 在锁外读回磁盘上的帧
+        std::vector<FramePtr> loaded;
+        loaded.reserve(batch.size());
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            if (!spilled[i] || load(*batch[i]))
+            {
+                loaded.push_back(std::move(batch[i]));
+                continue;
+            }
+            std::remove(batch[i]->filePath.c_str()); // 读不回来的帧文件不会再被retire，在这里删除
+            ++dropped;
+        }
+        return loaded;
+    }
+
+    void FrameStore::retire(const std::vector<FramePtr> &frames)
+    {
+        // 执行保留策略
+        switch (config.deletePolicy)
+        {
+        case DeletePolicy::KeepAll:
+            break;
+
+        case DeletePolicy::DeleteOnSuccess:
+        {
+            // 删除当前批次文件
+            for (const auto &frame : frames)
+            {
+                if (frame->filePath.empty())
+                    continue;
+                if (std::remove(frame->filePath.c_str()) != 0)
+                {
+                    std::cerr << "[FrameStore] 无法删除文件 '" << frame->filePath << "': " << strerror(errno) << std::endl;
+                }
+            }
+            break;
+        }
+
+        case DeletePolicy::DeleteWhenExceed:
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            // 将当前批次加入跟踪队列
+            for (const auto &frame : frames)
+            {
+                if (frame->filePath.empty())
+                    continue;
+                keptFiles.push_back({frame->filePath, frame->dataSize()});
+                keptBytes += frame->dataSize();
+            }
+
+            // 删除最早文件直到满足内存限制
+            const size_t maxBytes = config.maxMemoryMB * 1024 * 1024;
+            while (!keptFiles.empty() && keptBytes > maxBytes)
+            {
+                const auto &oldest = keptFiles.front();
+                std::remove(oldest.path.c_str());
+                keptBytes -= oldest.size;
+                keptFiles.pop_front();
+            }
+            break;
+        }
+        }
+    }
+
+    void FrameStore::clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (count > 0)
+        {
+            dropOldest();
+        }
+    }
+
+    size_t FrameStore::size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+
+    size_t FrameStore::memoryBytes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return bytesInMemory;
+    }
+
+    void FrameStore::copyToPool(Frame &frame)
+    {
+        auto buffer = pool->acquire(frame.dataSize());
+        std::memcpy(buffer->data(), frame.data(), frame.dataSize());
+        frame.payload = buffer;
+        frame.sdkFrame.reset();
+    }
+
+    bool FrameStore::writeFrame(const Frame &frame, std::string &path)
+    {
+        char filename[128];
+        snprintf(filename, sizeof(filename), "frame_%ld_%lu.%s",
+                 static_cast<long>(std::chrono::high_resolution_clock::now()
+                                       .time_since_epoch()
+                                       .count()),
+                 static_cast<unsigned long>(frame.index),
+                 frame.format == OB_FORMAT_MJPG ? "jpg" : "yuv"); // 未压缩帧原样写入，不转成JPEG
+        std::string savePath = config.tempDir + filename;
+
+        std::ofstream file(savePath, std::ios::binary); // 打开文件进行二进制写入
+        file.write(reinterpret_cast<const char *>(frame.data()), frame.dataSize()); // 写入帧数据
+        if (!file)
+        {
+            std::cerr << "[FrameStore] 帧写入失败: " << savePath << std::endl;
+            std::remove(savePath.c_str());
+            return false;
+        }
+        path = savePath;
+        return true;
+    }
+
+    void FrameStore::markSpilled(Entry &entry, const std::string &path)
+    {
+        Frame &frame = *entry.frame;
+        frame.filePath = path;
+        frame.payload.reset();
+        frame.sdkFrame.reset();
+        entry.inMemory = false;
+    }
+
+    FrameStore::Entry *FrameStore::find(const Frame *frame)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            Entry &entry = ring[(head + i) % ring.size()];
+            if (entry.frame.get() == frame)
+                return &entry;
+        }
+        return nullptr;
+    }
+
+    bool FrameStore::load(Frame &frame)
+    {
+        std::ifstream file(frame.filePath, std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+        {
+            std::cerr << "[FrameStore] 帧文件打开失败: " << frame.filePath << std::endl;
+            return false;
+        }
+
+        auto end = file.tellg();
+        if (end < 0)
+        {
+            std::cerr << "[FrameStore] 帧文件读取失败: " << frame.filePath << std::endl;
+            return false;
+        }
+        auto size = static_cast<size_t>(end);
+        auto buffer = pool->acquire(size);
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(buffer->data()), size);
+        frame.payload = buffer;
+        return static_cast<bool>(file);
+    }
+
+    void FrameStore::dropOldest()
+    {
+        Entry &entry = ring[head];
+        if (entry.inMemory)
+        {
+            bytesInMemory -= entry.bytes;
+        }
+        else
+        {
+            std::remove(entry.frame->filePath.c_str()); // 删除队列中的旧文件
+        }
+        entry = Entry();
+        head = (head + 1) % ring.size();
+        --count;
+    }
+} // namespace VideoStreamer
@@ -0,0 +1,141 @@
+#pragma once
+#include "config.hpp"
+#include "frame.hpp"
+#include "buffer_pool.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace VideoStreamer
+{
+    /**
+     * FrameStore类，待编码帧的有界环形缓冲区
+     * 内存模式下帧数据保存在内存中供编码器直接读取；磁盘模式或开启溢出时写入tempDir
+     * 同时受帧数（maxQueueSize）和字节数（maxQueueBytes）限制
+     */
+    class FrameStore
+    {
+    public:
+        explicit FrameStore(const AppConfig &cfg);
+
+        /**
+         * 存入一帧，超出上限时丢弃（或溢出到磁盘）最旧的帧，返回被丢弃的帧数
+         */
+        size_t push(const FramePtr &frame);
+
+        /**
+         * 按先后顺序取出最多maxCount帧，已溢出到磁盘的帧会被重新读入内存
+         * 读回失败的帧删除其文件后丢弃，丢弃的帧数写入dropped
+         */
+        std::vector<FramePtr> popBatch(size_t maxCount, size_t &dropped);
+
+        /**
+         * 等待缓冲区中至少有minCount帧，最多等待timeout
+         * 满足条件返回true；关闭后只要还有剩余帧也返回true，便于冲刷最后不足一批的帧
+         */
+        bool waitForFrames(size_t minCount, std::chrono::milliseconds timeout);
+
+        /**
+         * 关闭缓冲区，唤醒等待中的编码线程
+         */
+        void close();
+
+        /**
+         * 是否已关闭且没有剩余帧
+         */
+        bool drained() const;
+
+        /**
+         * 编码成功后处理批次中帧的磁盘副本（按deletePolicy）
+         */
+        void retire(const std::vector<FramePtr> &frames);
+
+        /**
+         * 清空缓冲区并删除所有磁盘副本
+         */
+        void clear();
+
+        /**
+         * 当前缓存的帧数
+         */
+        size_t size() const;
+
+        /**
+         * 当前占用的内存字节数（不含磁盘副本）
+         */
+        size_t memoryBytes() const;
+
+    private:
+        // 环形缓冲区中的一项
+        struct Entry
+        {
+            FramePtr frame;
+            size_t bytes = 0;      // 帧数据大小
+            bool inMemory = false; // 数据是否在内存中
+            bool spilling = false; // 正在锁外写入磁盘（写完之前数据仍在内存中，可以被正常取走）
+        };
+
+        // 磁盘副本信息，用于DeleteWhenExceed策略
+        struct FileInfo
+        {
+            std::string path;
+            size_t size;
+        };
+
+        /**
+         * 将帧数据复制到池化缓冲区，尽快释放SDK缓冲
+         */
+        void copyToPool(Frame &frame);
+
+        /**
+         * 将帧数据写入tempDir，成功时path返回文件路径；不修改帧，可以在锁外调用
+         */
+        bool writeFrame(const Frame &frame, std::string &path);
+
+        /**
+         * 帧数据已写入path：记录磁盘副本并释放内存
+         */
+        void markSpilled(Entry &entry, const std::string &path);
+
+        /**
+         * 查找仍在缓冲区中的帧（调用方需持有锁），不存在时返回nullptr
+         */
+        Entry *find(const Frame *frame);
+
+        /**
+         * 从磁盘读回帧数据
+         */
+        bool load(Frame &frame);
+
+        /**
+         * 丢弃最旧的一帧（调用方需持有锁）
+         */
+        void dropOldest();
+
+        // 配置参数
+        AppConfig config;
+
+        // 帧数据缓冲池
+        std::shared_ptr<BufferPool> pool;
+
+        // 环形缓冲区
+        std::vector<Entry> ring;
+        size_t head = 0;   // 最旧一帧的位置
+        size_t count = 0;  // 当前帧数
+        size_t bytesInMemory = 0;
+        size_t spillingBytes = 0; // 正在锁外写入磁盘的内存帧字节数
+
+        // 保留的磁盘副本（DeleteWhenExceed）
+        std::deque<FileInfo> keptFiles;
+        size_t keptBytes = 0;
+
+        bool closed = false;
+
+        mutable std::mutex mutex;
+        std::condition_variable framesReady; // 有新帧存入时通知
+    };
+} // namespace VideoStreamer
@@ -0,0 +1,168 @@
+#include "libav_encoder.hpp"
+#include <iostream>
+#include <stdexcept>
+
+extern "C"
+{
+#include <libavutil/opt.h>
+}
+
+namespace VideoStreamer
+{
+    namespace
+    {
+        // 将FFmpeg错误码转换为可读字符串
+        std::string avError(int code)
+        {
+            char buf[AV_ERROR_MAX_STRING_SIZE] = {0};
+            av_strerror(code, buf, sizeof(buf));
+            return buf;
+        }
+    } // namespace
+
+    LibavEncoder::LibavEncoder(const AppConfig &cfg, const EncoderOptions &opts) : config(cfg), options(opts)
+    {
+        packet = av_packet_alloc();
+        inputFrame = av_frame_alloc();
+        if (!packet || !inputFrame)
+        {
+            throw std::runtime_error("[LibavEncoder] 内存分配失败");
+        }
+    }
+
+    LibavEncoder::~LibavEncoder()
+    {
+        releaseEncoder();
+        av_frame_free(&inputFrame);
+        av_packet_free(&packet);
+    }
+
+    void LibavEncoder::initEncoder(int width, int height, AVPixelFormat pixelFormat)
+    {
+        releaseEncoder();
+
+        const AVCodec *encoder = avcodec_find_encoder_by_name("libx264");
+        if (!encoder)
+        {
+            throw std::runtime_error("[LibavEncoder] 未找到libx264编码器");
+        }
+
+        // 默认参数与CLI路径保持一致：3Mbps、关键帧间隔15；MJPEG输入（4:2:2）使用high422，未压缩输入转为4:2:0使用high
+        // 编码阶梯的缩小档位沿用源画面的像素格式
+        encoderCtx = avcodec_alloc_context3(encoder);
+        encoderCtx->width = width;
+        encoderCtx->height = height;
+        encoderCtx->pix_fmt = pixelFormat;
+        encoderCtx->time_base = AVRational{1, config.targetFPS};
+        encoderCtx->framerate = AVRational{config.targetFPS, 1};
+        encoderCtx->bit_rate = options.bitRate;
+        encoderCtx->gop_size = options.gopSize;
+        av_opt_set(encoderCtx->priv_data, "profile", pixelFormat == AV_PIX_FMT_YUV422P ? "high422" : "high", 0);
+        if (options.lowLatency)
+        {
+            // 零延迟：每送入一帧立即输出数据包，批次结束时无需冲刷编码器
+            encoderCtx->max_b_frames = 0;
+            av_opt_set(encoderCtx->priv_data, "tune", "zerolatency", 0);
+        }
+        if (options.globalHeader)
+        {
+            encoderCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+        // 强制关键帧输出为IDR，保证每个批次/分段可独立解码
+        av_opt_set(encoderCtx->priv_data, "forced-idr", "1", 0);
+
+        int ret = avcodec_open2(encoderCtx, encoder, nullptr);
+        if (ret < 0)
+        {
+            throw std::runtime_error("[LibavEncoder] libx264打开失败: " + avError(ret));
+        }
+
+        std::cout << "[LibavEncoder] 编码器已初始化 " << width << "x" << height << std::endl;
+    }
+
+    void LibavEncoder::releaseEncoder()
+    {
+        avcodec_free_context(&encoderCtx);
+        av_frame_unref(inputFrame);
+    }
+
+    void LibavEncoder::encodeFrame(AVFrame *frame, const PacketHandler &handler)
+    {
+        int ret = avcodec_send_frame(encoderCtx, frame);
+        if (ret < 0)
+        {
+            throw std::runtime_error("[LibavEncoder] 编码失败: " + avError(ret));
+        }
+
+        while ((ret = avcodec_receive_packet(encoderCtx, packet)) >= 0)
+        {
+            handler(packet);
+            av_packet_unref(packet);
+        }
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+        {
+            throw std::runtime_error("[LibavEncoder] 编码失败: " + avError(ret));
+        }
+    }
+
+    bool LibavEncoder::prepareFrame(const Frame &frame)
+    {
+        if (!ownPictures)
+            ownPictures.reset(new PictureLadder());
+        return ownPictures->load(frame) && preparePicture(*ownPictures);
+    }
+
+    bool LibavEncoder::preparePicture(PictureLadder &pictures)
+    {
+        prepared = pictures.picture(options.width, options.height);
+        if (!prepared)
+            return false;
+
+        // 分辨率或输入格式变化时重建编码器
+        const AVPixelFormat pixelFormat = static_cast<AVPixelFormat>(prepared->format);
+        if (!encoderCtx || encoderCtx->width != prepared->width || encoderCtx->height != prepared->height ||
+            encoderCtx->pix_fmt != pixelFormat)
+        {
+            initEncoder(prepared->width, prepared->height, pixelFormat);
+        }
+        return true;
+    }
+
+    void LibavEncoder::setBitRate(int64_t bitRate)
+    {
+        options.bitRate = bitRate; // 编码器重建时沿用新码率
+        if (encoderCtx)
+        {
+            encoderCtx->bit_rate = bitRate;
+        }
+    }
+
+    void LibavEncoder::encodePrepared(int64_t pts, bool forceKeyframe, const PacketHandler &handler)
+    {
+        if (!prepared)
+        {
+            throw std::runtime_error("[LibavEncoder] 没有已准备的输入画面");
+        }
+
+        // 引用共享的画面缓冲（不复制像素），时间戳和帧类型只设置在本编码器的引用上
+        av_frame_unref(inputFrame);
+        int ret = av_frame_ref(inputFrame, prepared);
+        prepared = nullptr;
+        if (ret < 0)
+        {
+            throw std::runtime_error("[LibavEncoder] 画面引用失败: " + avError(ret));
+        }
+        inputFrame->pict_type = forceKeyframe ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+        inputFrame->pts = pts;
+        encodeFrame(inputFrame, handler);
+        av_frame_unref(inputFrame);
+    }
+
+    void LibavEncoder::flush(const PacketHandler &handler)
+    {
+        if (!encoderCtx)
+            return;
+        encodeFrame(nullptr, handler);
+        releaseEncoder(); // 冲刷后编码器进入EOF状态，下一帧时重建
+    }
+} // namespace VideoStreamer
@@ -0,0 +1,105 @@
+#pragma once
+#include "config.hpp"
+#include "frame.hpp"
+#include "picture_ladder.hpp"
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+namespace VideoStreamer
+{
+    /**
+     * 编码器参数
+     */
+    struct EncoderOptions
+    {
+        int64_t bitRate = 3000000; // 码率（bps）
+        int gopSize = 15;          // 关键帧间隔
+        bool lowLatency = true;    // 零延迟模式（无B帧/前瞻，每帧立即输出）
+        bool globalHeader = false; // SPS/PPS放入extradata（MP4等容器需要）
+        int width = 0;             // 输出尺寸，0的含义与Rendition相同（都为0时与输入相同）
+        int height = 0;
+    };
+
+    /**
+     * LibavEncoder类，进程内的MJPEG解码 + H.264编码器
+     * 解码器/编码器上下文在多个批次之间保持复用，避免每批次fork ffmpeg并重新初始化libx264；
+     * 未压缩的YUYV/NV12帧不经过JPEG解码，由向量化的转换函数直接转换为I420编码输入
+     * 输入画面来自PictureLadder：单独使用时由自带的PictureLadder解码，编码阶梯中多个编码器共享同一个，
+     * 每帧只解码一次，各编码器按options中的输出尺寸取缩放后的画面
+     */
+    class LibavEncoder
+    {
+    public:
+        // 编码输出数据包的回调
+        using PacketHandler = std::function<void(AVPacket *)>;
+
+        LibavEncoder(const AppConfig &cfg, const EncoderOptions &opts);
+        ~LibavEncoder();
+
+        LibavEncoder(const LibavEncoder &) = delete;
+        LibavEncoder &operator=(const LibavEncoder &) = delete;
+
+        /**
+         * 解码（MJPEG）或转换（YUYV/NV12）一帧作为编码器输入，成功返回true
+         */
+        bool prepareFrame(const Frame &frame);
+
+        /**
+         * 从共享的PictureLadder取当前帧的输出尺寸画面作为编码器输入（pictures须已load该帧），成功返回true
+         */
+        bool preparePicture(PictureLadder &pictures);
+
+        /**
+         * 编码prepareFrame/preparePicture准备好的帧，输出的数据包交给handler
+         */
+        void encodePrepared(int64_t pts, bool forceKeyframe, const PacketHandler &handler);
+
+        /**
+         * 冲刷编码器中缓存的帧，之后编码器会在下一帧时重建
+         */
+        void flush(const PacketHandler &handler);
+
+        /**
+         * 调整码率，下一帧起生效（libx264在编码过程中重新配置码率控制）
+         */
+        void setBitRate(int64_t bitRate);
+
+        /**
+         * 编码器上下文（首帧之前为nullptr）
+         */
+        const AVCodecContext *context() const { return encoderCtx; }
+
+    private:
+        /**
+         * 按照图像尺寸和输入像素格式初始化（或重建）H.264编码器
+         */
+        void initEncoder(int width, int height, AVPixelFormat pixelFormat);
+
+        /**
+         * 释放编码器及相关缓冲
+         */
+        void releaseEncoder();
+
+        /**
+         * 编码一帧图像（nullptr表示冲刷），输出的数据包交给handler
+         */
+        void encodeFrame(AVFrame *frame, const PacketHandler &handler);
+
+        // 配置对象
+        AppConfig config;
+        EncoderOptions options;
+
+        std::unique_ptr<PictureLadder> ownPictures; // 单独使用时的解码/缩放（首次prepareFrame时创建）
+        AVCodecContext *encoderCtx = nullptr;   // H.264编码器上下文
+        AVPacket *packet = nullptr;             // 复用的数据包
+        const AVFrame *prepared = nullptr;      // 已准备的输入画面（属于PictureLadder，下一次load前有效）
+        AVFrame *inputFrame = nullptr;          // 送入编码器的画面引用（共享缓冲，另设时间戳和帧类型）
+    };
+} // namespace VideoStreamer
@@ -0,0 +1,176 @@
+#include "live_output.hpp"
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace VideoStreamer
+{
+    namespace
+    {
+        // rtp://使用RTP封装（每个NAL单元按RFC 6184分包），其他地址使用MPEG-TS
+        const char *liveFormat(const std::string &url)
+        {
+            return url.compare(0, 6, "rtp://") == 0 ? "rtp" : "mpegts";
+        }
+
+        bool sameStream(const AVCodecParameters *a, const AVCodecParameters *b)
+        {
+            return a->codec_id == b->codec_id && a->width == b->width && a->height == b->height &&
+                   a->extradata_size == b->extradata_size &&
+                   (a->extradata_size == 0 || memcmp(a->extradata, b->extradata, a->extradata_size) == 0);
+        }
+    } // namespace
+
+    LiveOutput::LiveOutput(const AppConfig &cfg)
+        : config(cfg),
+          queue(std::max<size_t>(cfg.liveQueuePackets, 1), OverflowPolicy::DropOldest)
+    {
+        avformat_network_init();
+        thread = std::thread(&LiveOutput::run, this);
+    }
+
+    LiveOutput::~LiveOutput()
+    {
+        queue.close(); // 发送线程发完剩余数据包后退出
+        if (thread.joinable())
+            thread.join();
+    }
+
+    void LiveOutput::setStream(const AVCodecParameters *codecpar, AVRational timeBase)
+    {
+        std::lock_guard<std::mutex> lock(streamMutex);
+        if (streamInfo && sameStream(streamInfo->codecpar, codecpar) &&
+            av_cmp_q(streamInfo->timeBase, timeBase) == 0)
+            return;
+
+        auto info = std::make_shared<StreamInfo>();
+        info->codecpar = avcodec_parameters_alloc();
+        if (!info->codecpar || avcodec_parameters_copy(info->codecpar, codecpar) < 0)
+        {
+            throw std::runtime_error("[LiveOutput] 内存分配失败");
+        }
+        info->timeBase = timeBase;
+        streamInfo = std::move(info);
+    }
+
+    void LiveOutput::push(const AVPacket *packet)
+    {
+        Item item;
+        {
+            std::lock_guard<std::mutex> lock(streamMutex);
+            item.info = streamInfo;
+        }
+        if (!item.info)
+            return; // 尚未设置视频流参数
+
+        AVPacket *clone = av_packet_clone(packet);
+        if (!clone)
+        {
+            ++dropped;
+            return;
+        }
+        item.packet.reset(clone, [](AVPacket *p)
+                          { av_packet_free(&p); });
+
+        Item evicted;
+        auto result = queue.push(std::move(item), &evicted);
+        if (result == PushResult::DroppedOldest)
+        {
+            ++dropped;
+            gap = true; // 丢弃的数据包可能是参考帧，之后从下一个关键帧开始发送
+        }
+    }
+
+    void LiveOutput::run()
+    {
+        Item item;
+        while (queue.waitPop(item))
+        {
+            const bool keyframe = (item.packet->flags & AV_PKT_FLAG_KEY) != 0;
+            if (gap && !keyframe)
+            {
+                ++dropped;
+                continue;
+            }
+            gap = false;
+
+            if (item.info != openedInfo)
+            {
+                // 视频流参数变化（例如编码器重建），重新打开封装器；接收端从下一个关键帧开始解码
+                close();
+                if (!keyframe || !open(item.info))
+                {
+                    ++dropped;
+                    continue;
+                }
+            }
+
+            AVPacket *packet = item.packet.get();
+            av_packet_rescale_ts(packet, item.info->timeBase, stream->time_base);
+            packet->stream_index = stream->index;
+            if (av_write_frame(muxer, packet) < 0)
+            {
+                ++dropped;
+                continue;
+            }
+            avio_flush(muxer->pb); // 每个数据包立即发出，不在AVIO缓冲中等待
+            ++sent;
+        }
+        close();
+    }
+
+    bool LiveOutput::open(const std::shared_ptr<const StreamInfo> &info)
+    {
+        const std::string &url = config.liveOutputUrl;
+        avformat_alloc_output_context2(&muxer, nullptr, liveFormat(url), url.c_str());
+        if (!muxer)
+        {
+            std::cerr << "[LiveOutput] 封装器创建失败: " << url << std::endl;
+            return false;
+        }
+        muxer->max_delay = 0; // MPEG-TS的PCR不预留复用延迟，接收端无需额外缓冲
+
+        stream = avformat_new_stream(muxer, nullptr);
+        avcodec_parameters_copy(stream->codecpar, info->codecpar);
+        stream->time_base = info->timeBase;
+
+        int ret = avio_open(&muxer->pb, url.c_str(), AVIO_FLAG_WRITE);
+        if (ret >= 0)
+            ret = avformat_write_header(muxer, nullptr);
+        if (ret < 0)
+        {
+            std::cerr << "[LiveOutput] 实时输出打开失败: " << url << std::endl;
+            close();
+            return false;
+        }
+
+        if (strcmp(liveFormat(url), "rtp") == 0)
+        {
+            // RTP接收端（ffplay/VLC）需要SDP描述才能解码
+            char sdp[2048];
+            if (av_sdp_create(&muxer, 1, sdp, sizeof(sdp)) == 0)
+                std::cout << "[LiveOutput] SDP:\n" << sdp << std::endl;
+        }
+        std::cout << "[LiveOutput] 实时输出: " << url << " (" << info->codecpar->width << "x"
+                  << info->codecpar->height << ")" << std::endl;
+        openedInfo = info;
+        return true;
+    }
+
+    void LiveOutput::close()
+    {
+        if (muxer)
+        {
+            if (muxer->pb)
+            {
+                if (openedInfo)
+                    av_write_trailer(muxer);
+                avio_closep(&muxer->pb);
+            }
+            avformat_free_context(muxer);
+        }
+        muxer = nullptr;
+        stream = nullptr;
+        openedInfo.reset();
+    }
+} // namespace VideoStreamer
@@ -0,0 +1,96 @@
+#pragma once
+#include "config.hpp"
+#include "thread_safe_queue.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+namespace VideoStreamer
+{
+    /**
+     * LiveOutput类，把编码输出的数据包实时发送到UDP目的地（MPEG-TS over UDP或RTP），供现场监看
+     * 编码线程只复制数据包并放入有界队列，由发送线程封装和发送；发送跟不上时丢弃最旧的数据包，
+     * 之后跳过非关键帧直到下一个关键帧，编码和采集永远不会因实时输出而阻塞
+     */
+    class LiveOutput
+    {
+    public:
+        explicit LiveOutput(const AppConfig &cfg);
+        ~LiveOutput();
+
+        LiveOutput(const LiveOutput &) = delete;
+        LiveOutput &operator=(const LiveOutput &) = delete;
+
+        /**
+         * 设置视频流参数（编码线程调用，参数未变化时忽略），之后的数据包按新参数发送
+         */
+        void setStream(const AVCodecParameters *codecpar, AVRational timeBase);
+
+        /**
+         * 复制一个数据包放入发送队列（编码线程调用，不阻塞）
+         */
+        void push(const AVPacket *packet);
+
+        /**
+         * 已发送和丢弃的数据包数
+         */
+        uint64_t sentPackets() const { return sent; }
+        uint64_t droppedPackets() const { return dropped; }
+
+    private:
+        // 视频流参数，同一组参数的数据包共享
+        struct StreamInfo
+        {
+            AVCodecParameters *codecpar = nullptr;
+            AVRational timeBase;
+            ~StreamInfo() { avcodec_parameters_free(&codecpar); }
+        };
+
+        // 发送队列中的一项
+        struct Item
+        {
+            std::shared_ptr<AVPacket> packet;
+            std::shared_ptr<const StreamInfo> info;
+        };
+
+        /**
+         * 发送线程主循环
+         */
+        void run();
+
+        /**
+         * 按info打开封装器和UDP输出，失败时返回false
+         */
+        bool open(const std::shared_ptr<const StreamInfo> &info);
+
+        /**
+         * 关闭封装器和UDP输出
+         */
+        void close();
+
+        // 配置参数
+        AppConfig config;
+
+        std::mutex streamMutex;
+        std::shared_ptr<const StreamInfo> streamInfo; // 最新的视频流参数（编码线程设置）
+
+        ThreadSafeQueue<Item> queue;        // 编码线程到发送线程的队列
+        std::atomic<bool> gap{false};       // 丢弃过数据包，发送线程等待下一个关键帧
+        std::atomic<uint64_t> sent{0};
+        std::atomic<uint64_t> dropped{0};
+
+        // 以下只由发送线程访问
+        AVFormatContext *muxer = nullptr;
+        AVStream *stream = nullptr;
+        std::shared_ptr<const StreamInfo> openedInfo; // muxer使用的视频流参数
+        std::thread thread;
+    };
+} // namespace VideoStreamer
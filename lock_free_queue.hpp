@@ -0,0 +1,202 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace VideoStreamer
+{
+    namespace detail
+    {
+        // 向上取整到2的幂，便于用掩码代替取模
+        inline size_t roundUpPow2(size_t n)
+        {
+            size_t v = 2;
+            while (v < n)
+                v <<= 1;
+            return v;
+        }
+
+        // 缓存行大小，用于隔离生产者/消费者的索引，避免伪共享
+        constexpr size_t CacheLine = 64;
+    } // namespace detail
+
+    /**
+     * 单生产者单消费者的有界无锁队列
+     * tryPush/tryPop均不阻塞，适用于采集线程向后续阶段交付帧
+     */
+    template <typename T>
+    class SpscQueue
+    {
+    public:
+        explicit SpscQueue(size_t capacity)
+            : mask(detail::roundUpPow2(capacity) - 1),
+              slots(mask + 1) {}
+
+        SpscQueue(const SpscQueue &) = delete;
+        SpscQueue &operator=(const SpscQueue &) = delete;
+
+        /**
+         * 压入一个值，队列已满时返回false（仅生产者线程调用）
+         */
+        bool tryPush(T value)
+        {
+            const size_t t = tail.load(std::memory_order_relaxed);
+            if (t - headCache > mask)
+            {
+                headCache = head.load(std::memory_order_acquire);
+                if (t - headCache > mask)
+                    return false;
+            }
+            slots[t & mask] = std::move(value);
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * 弹出一个值，队列为空时返回false（仅消费者线程调用）
+         */
+        bool tryPop(T &out)
+        {
+            const size_t h = head.load(std::memory_order_relaxed);
+            if (h == tailCache)
+            {
+                tailCache = tail.load(std::memory_order_acquire);
+                if (h == tailCache)
+                    return false;
+            }
+            out = std::move(slots[h & mask]);
+            slots[h & mask] = T();
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * 当前元素数量（近似值）
+         */
+        size_t size() const
+        {
+            return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+        }
+
+        size_t capacity() const { return mask + 1; }
+
+    private:
+        const size_t mask;
+        std::vector<T> slots;
+
+        alignas(detail::CacheLine) std::atomic<size_t> head{0}; // 消费者位置
+        size_t tailCache = 0;                                   // 消费者缓存的tail
+        alignas(detail::CacheLine) std::atomic<size_t> tail{0}; // 生产者位置
+        size_t headCache = 0;                                   // 生产者缓存的head
+    };
+
+    /**
+     * 多生产者多消费者的有界无锁队列（Vyukov算法，每个槽位带序号）
+     */
+    template <typename T>
+    class MpmcQueue
+    {
+    public:
+        explicit MpmcQueue(size_t capacity)
+            : mask(detail::roundUpPow2(capacity) - 1),
+              cells(new Cell[mask + 1])
+        {
+            for (size_t i = 0; i <= mask; ++i)
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        MpmcQueue(const MpmcQueue &) = delete;
+        MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+        /**
+         * 压入一个值，队列已满时返回false
+         */
+        bool tryPush(T value)
+        {
+            size_t pos = enqueuePos.load(std::memory_order_relaxed);
+            Cell *cell;
+            for (;;)
+            {
+                cell = &cells[pos & mask];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (diff == 0)
+                {
+                    if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    return false; // 队列已满
+                }
+                else
+                {
+                    pos = enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+            cell->value = std::move(value);
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * 弹出一个值，队列为空时返回false
+         */
+        bool tryPop(T &out)
+        {
+            size_t pos = dequeuePos.load(std::memory_order_relaxed);
+            Cell *cell;
+            for (;;)
+            {
+                cell = &cells[pos & mask];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0)
+                {
+                    if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    return false; // 队列为空
+                }
+                else
+                {
+                    pos = dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+            out = std::move(cell->value);
+            cell->value = T();
+            cell->sequence.store(pos + mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * 当前元素数量（近似值）
+         */
+        size_t size() const
+        {
+            size_t e = enqueuePos.load(std::memory_order_acquire);
+            size_t d = dequeuePos.load(std::memory_order_acquire);
+            return e > d ? e - d : 0;
+        }
+
+        size_t capacity() const { return mask + 1; }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        const size_t mask;
+        std::unique_ptr<Cell[]> cells;
+
+        alignas(detail::CacheLine) std::atomic<size_t> enqueuePos{0};
+        alignas(detail::CacheLine) std::atomic<size_t> dequeuePos{0};
+    };
+} // namespace VideoStreamer
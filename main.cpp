@@ -1,14 +1,74 @@
 #include "stream_processor.hpp"
+#include <cerrno>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <thread>
 #include <iostream>
+#include <string>
 
-int main() {
+int main(int argc, char *argv[]) {
     using namespace VideoStreamer;
     
     AppConfig config;
     config.targetFPS = 15;  // 设置目标帧率为15帧每秒
     config.uploadThreads = 4;   // 设置上传线程数为4
+
+    // 可选参数：synthetic | replay <path>，--free-run（不限帧率），--poll-capture（摄像头改用轮询采集），
+    // 可重复的 --camera <序列号>（多摄像头，每个摄像头上传到 uploadPrefix/<序列号>/），
+    // --live <udp://或rtp://地址>（实时输出，与上传并行），
+    // --event-socket <路径>（事件录制：只在收到触发命令时上传事件前后的画面），
+    // --upload-rate <字节/秒>（上传带宽上限，积压只使用新分段用剩的带宽），
+    // 以及 --preview <宽>x<高>:<码率>（同一次解码额外编码一路预览，上传到 <前缀>preview/）
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "synthetic") {
+            config.frameSource = FrameSourceType::Synthetic;
+        } else if (arg == "replay" && i + 1 < argc) {
+            config.frameSource = FrameSourceType::Replay;
+            config.replayPath = argv[++i];
+        } else if (arg == "--free-run") {
+            config.freeRun = true;
+        } else if (arg == "--poll-capture") {
+            config.captureMode = CaptureMode::Polling;
+        } else if (arg == "--live" && i + 1 < argc) {
+            config.liveOutputUrl = argv[++i];
+        } else if (arg == "--event-socket" && i + 1 < argc) {
+            config.recordingMode = RecordingMode::Event;
+            config.eventSocketPath = argv[++i];
+        } else if (arg == "--upload-rate" && i + 1 < argc) {
+            const char *value = argv[++i];
+            char *end = nullptr;
+            errno = 0;
+            unsigned long long rate = strtoull(value, &end, 10);
+            // strtoull会接受负数并回绕成很大的值，这里只接受纯数字
+            if (value[0] < '0' || value[0] > '9' || *end != '\0' || errno == ERANGE) {
+                std::cerr << "Invalid --upload-rate, expected <bytes/s>" << std::endl;
+                return 1;
+            }
+            config.uploadRateBytesPerSec = rate;
+        } else if (arg == "--preview" && i + 1 < argc) {
+            Rendition preview;
+            long long bitRate = 0;
+            if (sscanf(argv[++i], "%dx%d:%lld", &preview.width, &preview.height, &bitRate) != 3) {
+                std::cerr << "Invalid --preview, expected <width>x<height>:<bitrate>" << std::endl;
+                return 1;
+            }
+            preview.name = "preview";
+            preview.bitRate = bitRate;
+            preview.uploadPrefix = "preview/";
+            Rendition archive;  // 全分辨率归档，使用摄像头前缀和bitRate
+            archive.name = "main";
+            config.renditions = {archive, preview};
+        } else if (arg == "--camera" && i + 1 < argc) {
+            CameraConfig camera;
+            camera.serialNumber = argv[++i];
+            config.cameras.push_back(camera);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [synthetic | replay <path>] [--free-run] [--poll-capture] [--camera <serial>]... [--live <url>] [--event-socket <path>] [--upload-rate <bytes/s>] [--preview <w>x<h>:<bps>]" << std::endl;
+            return 1;
+        }
+    }
     
     try {
         StreamProcessor processor(config);
@@ -22,4 +82,4 @@ int main() {
     }
     
     return 0;
-}
\ No newline at end of file
+}
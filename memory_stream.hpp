@@ -0,0 +1,78 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <vector>
+
+namespace VideoStreamer
+{
+    /**
+     * MemoryStreamBuf类，只读地引用共享内存缓冲中的一段数据（不复制）
+     * 支持定位，以便OSS SDK计算内容长度和重试时回绕
+     */
+    class MemoryStreamBuf : public std::streambuf
+    {
+    public:
+        MemoryStreamBuf(std::shared_ptr<const std::vector<uint8_t>> data, size_t offset, size_t size)
+            : buffer(std::move(data))
+        {
+            char *begin = reinterpret_cast<char *>(const_cast<uint8_t *>(buffer->data())) + offset;
+            setg(begin, begin, begin + size);
+        }
+
+    protected:
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+        {
+            if (!(which & std::ios_base::in))
+                return pos_type(off_type(-1));
+
+            off_type base = 0;
+            if (dir == std::ios_base::cur)
+                base = gptr() - eback();
+            else if (dir == std::ios_base::end)
+                base = egptr() - eback();
+
+            off_type target = base + off;
+            if (target < 0 || target > egptr() - eback())
+                return pos_type(off_type(-1));
+            setg(eback(), eback() + target, egptr());
+            return pos_type(target);
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+        {
+            return seekoff(off_type(pos), std::ios_base::beg, which);
+        }
+
+        std::streamsize showmanyc() override
+        {
+            return egptr() - gptr();
+        }
+
+    private:
+        // 持有缓冲的引用，保证上传期间数据不被释放
+        std::shared_ptr<const std::vector<uint8_t>> buffer;
+    };
+
+    /**
+     * MemoryStream类，基于MemoryStreamBuf的iostream，可直接传给PutObjectRequest/UploadPartRequest
+     */
+    class MemoryStream : public std::iostream
+    {
+    public:
+        explicit MemoryStream(std::shared_ptr<const std::vector<uint8_t>> data)
+            : MemoryStream(data, 0, data->size()) {}
+
+        MemoryStream(std::shared_ptr<const std::vector<uint8_t>> data, size_t offset, size_t size)
+            : std::iostream(nullptr),
+              streamBuf(std::move(data), offset, size)
+        {
+            rdbuf(&streamBuf);
+        }
+
+    private:
+        MemoryStreamBuf streamBuf;
+    };
+} // namespace VideoStreamer
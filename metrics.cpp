@@ -0,0 +1,234 @@
+#include "metrics.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace VideoStreamer
+{
+    namespace
+    {
+        std::string formatValue(double value)
+        {
+            std::ostringstream out;
+            out.precision(10);
+            out << value;
+            return out.str();
+        }
+    } // namespace
+
+    Histogram::Histogram(std::vector<double> b)
+        : bounds(std::move(b)),
+          buckets(new std::atomic<uint64_t>[bounds.size() + 1])
+    {
+        std::sort(bounds.begin(), bounds.end());
+        for (size_t i = 0; i <= bounds.size(); ++i)
+        {
+            buckets[i] = 0;
+        }
+    }
+
+    void Histogram::observe(double value)
+    {
+        size_t i = std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+        buckets[i].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+
+        double current = sum.load(std::memory_order_relaxed);
+        while (!sum.compare_exchange_weak(current, current + value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void Histogram::render(std::string &out, const std::string &name) const
+    {
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < bounds.size(); ++i)
+        {
+            cumulative += buckets[i].load(std::memory_order_relaxed);
+            out += name + "_bucket{le=\"" + formatValue(bounds[i]) + "\"} " + std::to_string(cumulative) + "\n";
+        }
+        cumulative += buckets[bounds.size()].load(std::memory_order_relaxed);
+        out += name + "_bucket{le=\"+Inf\"} " + std::to_string(cumulative) + "\n";
+        out += name + "_sum " + formatValue(sum.load(std::memory_order_relaxed)) + "\n";
+        out += name + "_count " + std::to_string(count.load(std::memory_order_relaxed)) + "\n";
+    }
+
+    void MetricsRegistry::counter(const std::string &name, const std::string &help, std::function<double()> value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        metrics.push_back(Metric{name, help, "counter", std::move(value), nullptr});
+    }
+
+    void MetricsRegistry::gauge(const std::string &name, const std::string &help, std::function<double()> value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        metrics.push_back(Metric{name, help, "gauge", std::move(value), nullptr});
+    }
+
+    Histogram &MetricsRegistry::histogram(const std::string &name, const std::string &help, std::vector<double> bounds)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        metrics.push_back(Metric{name, help, "histogram", nullptr, std::unique_ptr<Histogram>(new Histogram(std::move(bounds)))});
+        return *metrics.back().histogram;
+    }
+
+    std::string MetricsRegistry::render() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string out;
+        for (const auto &metric : metrics)
+        {
+            out += "# HELP " + metric.name + " " + metric.help + "\n";
+            out += "# TYPE " + metric.name + " " + metric.type + "\n";
+            if (metric.histogram)
+                metric.histogram->render(out, metric.name);
+            else
+                out += metric.name + " " + formatValue(metric.value()) + "\n";
+        }
+        return out;
+    }
+
+    MetricsExporter::MetricsExporter(const AppConfig &cfg, const MetricsRegistry &reg)
+        : config(cfg), registry(reg)
+    {
+    }
+
+    MetricsExporter::~MetricsExporter()
+    {
+        stop();
+    }
+
+    void MetricsExporter::start()
+    {
+        if (config.metricsFile.empty() && config.metricsPort <= 0)
+            return;
+        if (config.metricsPort > 0 && !openListener())
+        {
+            std::cerr << "[MetricsExporter] 端口 " << config.metricsPort << " 监听失败: " << strerror(errno) << std::endl;
+        }
+
+        running = true;
+        thread = std::thread(&MetricsExporter::run, this);
+    }
+
+    void MetricsExporter::stop()
+    {
+        if (!running.exchange(false))
+            return;
+        if (thread.joinable())
+            thread.join();
+        if (listenFd >= 0)
+        {
+            close(listenFd);
+            listenFd = -1;
+        }
+        if (!config.metricsFile.empty())
+            writeFile(); // 退出前写一次，保留最终的统计
+    }
+
+    void MetricsExporter::run()
+    {
+        auto nextWrite = std::chrono::steady_clock::now();
+        while (running)
+        {
+            if (!config.metricsFile.empty() && std::chrono::steady_clock::now() >= nextWrite)
+            {
+                writeFile();
+                nextWrite += std::chrono::milliseconds(config.metricsIntervalMs);
+            }
+
+            if (listenFd >= 0)
+            {
+                // 等待HTTP连接，超时后回到循环检查running和写文件周期
+                pollfd pfd{listenFd, POLLIN, 0};
+                if (poll(&pfd, 1, 200) > 0 && (pfd.revents & POLLIN))
+                {
+                    int fd = accept(listenFd, nullptr, nullptr);
+                    if (fd >= 0)
+                        serveClient(fd);
+                }
+            }
+            else
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            }
+        }
+    }
+
+    void MetricsExporter::writeFile()
+    {
+        const std::string tmpPath = config.metricsFile + ".tmp";
+        {
+            std::ofstream out(tmpPath, std::ios::trunc);
+            out << registry.render();
+            if (!out)
+            {
+                std::cerr << "[MetricsExporter] 指标文件写入失败: " << tmpPath << std::endl;
+                return;
+            }
+        }
+        std::rename(tmpPath.c_str(), config.metricsFile.c_str());
+    }
+
+    bool MetricsExporter::openListener()
+    {
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd < 0)
+            return false;
+
+        int reuse = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(config.metricsPort));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // 只监听本机
+        if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(listenFd, 4) != 0)
+        {
+            close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        std::cout << "[MetricsExporter] 指标地址: http://127.0.0.1:" << config.metricsPort << "/metrics" << std::endl;
+        return true;
+    }
+
+    void MetricsExporter::serveClient(int fd)
+    {
+        // 读取请求头（内容不重要，任何路径都返回指标）
+        pollfd pfd{fd, POLLIN, 0};
+        char request[1024];
+        if (poll(&pfd, 1, 1000) > 0)
+        {
+            ssize_t ignored = read(fd, request, sizeof(request));
+            (void)ignored;
+        }
+
+        std::string body = registry.render();
+        std::string response = "HTTP/1.1 200 OK\r\n";
+        response += "Content-Type: text/plain; version=0.0.4\r\n";
+        response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+        response += "Connection: close\r\n\r\n";
+        response += body;
+        size_t sent = 0;
+        while (sent < response.size())
+        {
+            ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0)
+                break;
+            sent += static_cast<size_t>(n);
+        }
+        close(fd);
+    }
+} // namespace VideoStreamer
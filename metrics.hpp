@@ -0,0 +1,132 @@
+#pragma once
+#include "config.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace VideoStreamer
+{
+    /**
+     * Histogram类，固定桶边界的直方图，observe无锁，可在任意线程调用
+     */
+    class Histogram
+    {
+    public:
+        explicit Histogram(std::vector<double> bounds);
+
+        /**
+         * 记录一个观测值
+         */
+        void observe(double value);
+
+        /**
+         * 以Prometheus文本格式输出（桶计数为累计值）
+         */
+        void render(std::string &out, const std::string &name) const;
+
+    private:
+        std::vector<double> bounds;                         // 各桶的上界（升序）
+        std::unique_ptr<std::atomic<uint64_t>[]> buckets;   // 每个桶（含+Inf）的计数
+        std::atomic<uint64_t> count{0};                     // 观测次数
+        std::atomic<double> sum{0.0};                       // 观测值之和
+    };
+
+    /**
+     * MetricsRegistry类，登记各阶段指标并输出Prometheus文本格式
+     * 计数器和队列深度通过回调在导出时读取，热路径上只有原有的原子计数
+     */
+    class MetricsRegistry
+    {
+    public:
+        /**
+         * 登记计数器（单调递增），value在导出时调用
+         */
+        void counter(const std::string &name, const std::string &help, std::function<double()> value);
+
+        /**
+         * 登记瞬时值（例如队列深度），value在导出时调用
+         */
+        void gauge(const std::string &name, const std::string &help, std::function<double()> value);
+
+        /**
+         * 登记直方图，返回的引用在registry生命周期内有效
+         */
+        Histogram &histogram(const std::string &name, const std::string &help, std::vector<double> bounds);
+
+        /**
+         * 输出所有指标的Prometheus文本格式
+         */
+        std::string render() const;
+
+    private:
+        struct Metric
+        {
+            std::string name;
+            std::string help;
+            std::string type;                    // counter / gauge / histogram
+            std::function<double()> value;       // counter / gauge
+            std::unique_ptr<Histogram> histogram; // histogram
+        };
+
+        mutable std::mutex mutex;
+        std::vector<Metric> metrics;
+    };
+
+    /**
+     * MetricsExporter类，周期性地把指标写入文本文件（供node_exporter textfile采集），
+     * 并/或在localhost端口上提供HTTP /metrics
+     */
+    class MetricsExporter
+    {
+    public:
+        MetricsExporter(const AppConfig &cfg, const MetricsRegistry &registry);
+        ~MetricsExporter();
+
+        MetricsExporter(const MetricsExporter &) = delete;
+        MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+        /**
+         * 启动导出线程（文件和HTTP都未配置时不启动）
+         */
+        void start();
+
+        /**
+         * 停止导出线程，并最后写一次文件
+         */
+        void stop();
+
+    private:
+        /**
+         * 导出线程主循环
+         */
+        void run();
+
+        /**
+         * 将指标写入文件（先写临时文件再rename，读取方不会看到写了一半的内容）
+         */
+        void writeFile();
+
+        /**
+         * 在localhost上监听HTTP端口，失败时返回false
+         */
+        bool openListener();
+
+        /**
+         * 处理一个HTTP连接
+         */
+        void serveClient(int fd);
+
+        // 配置参数
+        AppConfig config;
+        const MetricsRegistry &registry;
+
+        std::atomic<bool> running{false};
+        std::thread thread;
+        int listenFd = -1;
+    };
+} // namespace VideoStreamer
@@ -0,0 +1,198 @@
+#include "motion_detector.hpp"
+#include "pixel_convert.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace VideoStreamer
+{
+    namespace
+    {
+        // 解码时的缩小倍数：2^3 = 1/8，720p得到160x90的亮度图
+        const char *kLowres = "3";
+
+        // 未压缩帧的缩小倍数与之一致，每个8x8块隔行隔列取16个亮度样本平均
+        const int kBlock = 8;
+    } // namespace
+
+    size_t countChangedPixels(const uint8_t *a, const uint8_t *b, size_t count, uint8_t threshold)
+    {
+        size_t changed = 0;
+        size_t i = 0;
+#if defined(__SSE2__)
+        // |a-b| = sat(a-b) | sat(b-a)；减去阈值后仍非零的字节即为变化像素
+        const __m128i thr = _mm_set1_epi8(static_cast<char>(threshold));
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+            __m128i diff = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+            __m128i same = _mm_cmpeq_epi8(_mm_subs_epu8(diff, thr), zero);
+            changed += 16 - __builtin_popcount(static_cast<unsigned>(_mm_movemask_epi8(same)));
+        }
+#elif defined(__ARM_NEON)
+        // 变化像素的掩码右移7位得到0/1，逐级成对累加到32位
+        const uint8x16_t thr = vdupq_n_u8(threshold);
+        uint32x4_t acc = vdupq_n_u32(0);
+        for (; i + 16 <= count; i += 16)
+        {
+            uint8x16_t diff = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+            uint8x16_t ones = vshrq_n_u8(vcgtq_u8(diff, thr), 7);
+            acc = vpadalq_u16(acc, vpaddlq_u8(ones));
+        }
+        changed += vgetq_lane_u32(acc, 0) + vgetq_lane_u32(acc, 1) + vgetq_lane_u32(acc, 2) + vgetq_lane_u32(acc, 3);
+#endif
+        for (; i < count; ++i)
+        {
+            int diff = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+            if (diff > threshold || -diff > threshold)
+                ++changed;
+        }
+        return changed;
+    }
+
+    MotionDetector::MotionDetector(const AppConfig &cfg) : config(cfg)
+    {
+        packet = av_packet_alloc();
+        decodedFrame = av_frame_alloc();
+        if (!packet || !decodedFrame)
+        {
+            throw std::runtime_error("[MotionDetector] 内存分配失败");
+        }
+
+        const AVCodec *decoder = avcodec_find_decoder(AV_CODEC_ID_MJPEG);
+        if (!decoder)
+        {
+            throw std::runtime_error("[MotionDetector] 未找到MJPEG解码器");
+        }
+        decoderCtx = avcodec_alloc_context3(decoder);
+
+        AVDictionary *opts = nullptr;
+        av_dict_set(&opts, "lowres", kLowres, 0);
+        int ret = avcodec_open2(decoderCtx, decoder, &opts);
+        av_dict_free(&opts);
+        if (ret < 0)
+        {
+            throw std::runtime_error("[MotionDetector] MJPEG解码器打开失败");
+        }
+    }
+
+    MotionDetector::~MotionDetector()
+    {
+        avcodec_free_context(&decoderCtx);
+        av_frame_free(&decodedFrame);
+        av_packet_free(&packet);
+    }
+
+    bool MotionDetector::sampleRawLuma(const Frame &frame)
+    {
+        const int width = static_cast<int>(frame.width);
+        const int height = static_cast<int>(frame.height);
+        const size_t expected = rawFrameSize(frame.format, width, height);
+        if (expected == 0 || frame.dataSize() < expected)
+            return false;
+
+        // YUYV的亮度在偶数字节，NV12的亮度平面在前
+        const size_t step = frame.format == OB_FORMAT_YUYV ? 2 : 1;
+        const size_t stride = static_cast<size_t>(width) * step;
+        const uint8_t *luma = frame.data();
+
+        currentWidth = width / kBlock;
+        currentHeight = height / kBlock;
+        current.resize(static_cast<size_t>(currentWidth) * currentHeight);
+        for (int by = 0; by < currentHeight; ++by)
+        {
+            for (int bx = 0; bx < currentWidth; ++bx)
+            {
+                unsigned sum = 0;
+                for (int y = 0; y < kBlock; y += 2)
+                {
+                    const uint8_t *row = luma + static_cast<size_t>(by * kBlock + y) * stride + bx * kBlock * step;
+                    for (int x = 0; x < kBlock; x += 2)
+                        sum += row[x * step];
+                }
+                current[static_cast<size_t>(by) * currentWidth + bx] = static_cast<uint8_t>(sum / 16);
+            }
+        }
+        return !current.empty();
+    }
+
+    bool MotionDetector::extractLuma(const Frame &frame)
+    {
+        if (isRawFormat(frame.format))
+            return sampleRawLuma(frame);
+        if (frame.format != OB_FORMAT_MJPG)
+            return false;
+
+        packet->data = const_cast<uint8_t *>(frame.data());
+        packet->size = static_cast<int>(frame.dataSize());
+        int ret = avcodec_send_packet(decoderCtx, packet);
+        packet->data = nullptr;
+        packet->size = 0;
+        if (ret < 0 || avcodec_receive_frame(decoderCtx, decodedFrame) < 0)
+        {
+            std::cerr << "[MotionDetector] JPEG解码失败，帧 " << frame.index << std::endl;
+            return false;
+        }
+
+        // 复制亮度平面（去掉行填充），与上一帧逐像素比较
+        currentWidth = decodedFrame->width;
+        currentHeight = decodedFrame->height;
+        current.resize(static_cast<size_t>(currentWidth) * currentHeight);
+        for (int y = 0; y < currentHeight; ++y)
+        {
+            memcpy(current.data() + static_cast<size_t>(y) * currentWidth,
+                   decodedFrame->data[0] + static_cast<size_t>(y) * decodedFrame->linesize[0], currentWidth);
+        }
+        av_frame_unref(decodedFrame);
+        return true;
+    }
+
+    bool MotionDetector::admit(Frame &frame)
+    {
+        if (!extractLuma(frame))
+        {
+            frame.motion = -1.0f;
+            return true;
+        }
+
+        if (previous.empty() || previousWidth != currentWidth || previousHeight != currentHeight)
+        {
+            frame.motion = 1.0f; // 第一帧或分辨率变化，视为场景变化
+        }
+        else
+        {
+            size_t changed = countChangedPixels(current.data(), previous.data(), current.size(),
+                                                static_cast<uint8_t>(config.motionPixelThreshold));
+            frame.motion = static_cast<float>(changed) / static_cast<float>(current.size());
+        }
+        previous.swap(current);
+        previousWidth = currentWidth;
+        previousHeight = currentHeight;
+
+        const auto now = frame.captureTime;
+        if (frame.motion >= config.motionThreshold)
+        {
+            lastMotion = now;
+            hasMotion = true;
+        }
+        isActive = hasMotion && now - lastMotion < std::chrono::milliseconds(config.motionHoldMs);
+
+        // 活动期间保留全部帧；静止期间按保活间隔保留
+        if (isActive || !hasKept || now - lastKept >= std::chrono::milliseconds(config.staticKeepAliveMs))
+        {
+            lastKept = now;
+            hasKept = true;
+            return true;
+        }
+        return false;
+    }
+} // namespace VideoStreamer
@@ -0,0 +1,80 @@
+#pragma once
+#include "config.hpp"
+#include "frame.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+namespace VideoStreamer
+{
+    /**
+     * 统计两幅亮度图中差值超过threshold的像素数（SSE2/NEON实现，其他平台为标量实现）
+     */
+    size_t countChangedPixels(const uint8_t *a, const uint8_t *b, size_t count, uint8_t threshold);
+
+    /**
+     * MotionDetector类，帧间运动/场景变化检测
+     * MJPEG帧以1/8分辨率解码（只使用DCT直流分量，几乎不需要反变换），
+     * 未压缩的YUYV/NV12帧直接按8x8块对亮度抽样平均，得到同样尺寸的缩小亮度图；
+     * 与上一帧的缩小亮度图逐像素比较，变化像素比例写入Frame::motion；
+     * 画面静止时按staticKeepAliveMs的间隔保留帧，检测到运动后motionHoldMs内保留全部帧
+     */
+    class MotionDetector
+    {
+    public:
+        explicit MotionDetector(const AppConfig &cfg);
+        ~MotionDetector();
+
+        MotionDetector(const MotionDetector &) = delete;
+        MotionDetector &operator=(const MotionDetector &) = delete;
+
+        /**
+         * 分析一帧并写入frame.motion，返回true表示保留该帧，false表示静止期间可以跳过
+         * 无法分析的帧（不支持的格式或解码失败）总是保留
+         */
+        bool admit(Frame &frame);
+
+        /**
+         * 当前是否处于活动状态（最近motionHoldMs内检测到运动）
+         */
+        bool active() const { return isActive; }
+
+    private:
+        /**
+         * 以缩小分辨率解码JPEG，把亮度平面写入current，成功返回true
+         */
+        bool extractLuma(const Frame &frame);
+
+        /**
+         * 从未压缩帧的亮度按8x8块抽样平均，写入current，数据大小不符时返回false
+         */
+        bool sampleRawLuma(const Frame &frame);
+
+        // 配置参数
+        AppConfig config;
+
+        AVCodecContext *decoderCtx = nullptr; // 低分辨率MJPEG解码器
+        AVPacket *packet = nullptr;           // 复用的数据包
+        AVFrame *decodedFrame = nullptr;      // 解码输出帧
+
+        std::vector<uint8_t> previous; // 上一帧的缩小亮度图
+        std::vector<uint8_t> current;  // 当前帧的缩小亮度图
+        int previousWidth = 0;         // 上一帧亮度图的尺寸
+        int previousHeight = 0;
+        int currentWidth = 0;          // 当前帧亮度图的尺寸
+        int currentHeight = 0;
+
+        std::atomic<bool> isActive{false}; // 是否处于活动状态（指标线程读取）
+        bool hasMotion = false;        // 是否检测到过运动
+        bool hasKept = false;          // 是否保留过帧
+        std::chrono::system_clock::time_point lastMotion; // 最近一次检测到运动的采集时刻
+        std::chrono::system_clock::time_point lastKept;   // 最近一次保留帧的采集时刻
+    };
+} // namespace VideoStreamer
@@ -1,14 +1,126 @@
 #include "oss_uploader.hpp"
+#include "memory_stream.hpp"
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <chrono>
+#include <condition_variable>
 #include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
 #include <unistd.h>
 
 namespace VideoStreamer
 {
-    OSSUploader::OSSUploader(const AppConfig &cfg) : config(cfg)
+    namespace
+    {
+        // 断点文件路径：本地文件路径加 .ucp 后缀
+        std::string checkpointPath(const std::string &path)
+        {
+            return path + ".ucp";
+        }
+
+        int64_t toMillis(std::chrono::system_clock::time_point t)
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count();
+        }
+
+        // 关键帧索引写入元数据的长度上限（OSS用户元数据总长度不超过8KB）
+        const size_t kMaxIndexMetaLength = 4096;
+
+        // 保留追加状态的清单对象数，超出时淘汰最早的、没有待重试内容的小时
+        const size_t kMaxManifests = 64;
+
+        // 单个清单待重试内容的上限，OSS长时间不可用时不无限占用内存
+        const size_t kMaxManifestPending = 1024 * 1024;
+
+        // 带OSS错误码的异常，用于识别已失效的分片上传
+        struct OssError : std::runtime_error
+        {
+            OssError(const std::string &code, const std::string &message)
+                : std::runtime_error("[OSSUploader] OSS Error: " + message), code(code) {}
+            std::string code;
+        };
+    } // namespace
+
+    // 排队中的辅助任务可能在分片上传结束后才执行，因此由shared_ptr持有，执行时发现已无分片可领取就直接返回
+    struct OSSUploader::MultipartJob
+    {
+        MultipartCheckpoint checkpoint;
+        Segment segment;
+        UploadLane lane = UploadLane::Live;
+        std::vector<int> missing; // 尚未完成的分片号
+        size_t next = 0;          // 下一个待领取的分片（missing的下标）
+        size_t inFlight = 0;      // 已领取、尚未完成的分片数
+        bool failed = false;
+        bool uploadExpired = false;
+        std::string firstError;
+        std::mutex mutex;
+        std::condition_variable idle; // inFlight降为0时通知
+    };
+
+    OSSUploader::OSSUploader(const AppConfig &cfg) : config(cfg), shaper(cfg)
     {
         initClient();
+        for (int i = 0; i < std::max(config.uploadThreads, 1); ++i)
+        {
+            requestThreads.emplace_back(&OSSUploader::requestLoop, this, std::ref(requests));
+        }
+        for (int i = 1; i < config.multipartParallelism; ++i)
+        {
+            partThreads.emplace_back(&OSSUploader::requestLoop, this, std::ref(partTasks));
+        }
+    }
+
+    OSSUploader::~OSSUploader()
+    {
+        requests.close(); // 已提交的任务执行完后请求线程退出
+        for (auto &t : requestThreads)
+        {
+            t.join();
+        }
+        partTasks.close(); // 请求线程中的分片上传都已结束，剩余的辅助任务会立即返回
+        for (auto &t : partThreads)
+        {
+            t.join();
+        }
+    }
+
+    void OSSUploader::requestLoop(ThreadSafeQueue<std::function<void()>> &tasks)
+    {
+        std::function<void()> task;
+        while (tasks.waitPop(task))
+        {
+            task();
+        }
+    }
+
+    std::future<bool> OSSUploader::uploadSegmentAsync(const Segment &segment, UploadCallback callback, UploadLane lane)
+    {
+        auto task = std::make_shared<std::packaged_task<bool()>>(
+            [this, segment, callback, lane]()
+            {
+                bool ok = uploadSegment(segment, lane);
+                if (callback)
+                    callback(segment, ok);
+                return ok;
+            });
+        auto future = task->get_future();
+        if (requests.push([task]()
+                          { (*task)(); }) != PushResult::Ok)
+        {
+            // 上传器正在析构，直接在调用线程上报告失败
+            if (callback)
+                callback(segment, false);
+            std::promise<bool> failed;
+            failed.set_value(false);
+            return failed.get_future();
+        }
+        return future;
     }
 
     /**
@@ -18,7 +130,9 @@ namespace VideoStreamer
     {
         // 配置OSS客户端的一些基本设置，例如最大连接数
         AlibabaCloud::OSS::ClientConfiguration ossConfig;
-        ossConfig.maxConnections = 10;
+        // 连接池由所有请求线程和分片线程共享
+        ossConfig.maxConnections = std::max(config.uploadConnections,
+                                            config.uploadThreads + std::max(config.multipartParallelism - 1, 0));
         ossConfig.connectTimeoutMs = config.connectTimeoutMs;
         ossConfig.requestTimeoutMs = config.requestTimeoutMs;
 
@@ -36,14 +150,14 @@ namespace VideoStreamer
         return access(path.c_str(), F_OK) != -1;
     }
 
-    std::string OSSUploader::generateObjectName()
+    std::string OSSUploader::generateObjectName(const Segment &segment)
     {
-        return config.uploadPrefix + // 上传路径前缀（例如："live/"）
+        return (segment.objectPrefix.empty() ? config.uploadPrefix : segment.objectPrefix) + // 上传路径前缀（例如："live/"）
                std::to_string(
                    std::chrono::high_resolution_clock::now() // 当前时间戳
                        .time_since_epoch()
                        .count()) +
-               ".h264"; // 文件后缀为.h264
+               segment.extension; // 文件后缀（.h264/.ts/.mp4）
     }
 
     std::shared_ptr<std::iostream> OSSUploader::openFileStream(const std::string &path)
@@ -60,12 +174,41 @@ namespace VideoStreamer
         return stream; // 返回文件流
     }
 
-    void OSSUploader::executeUpload(const std::string &objectName, const std::shared_ptr<std::iostream> &stream)
+    std::shared_ptr<std::iostream> OSSUploader::throttle(std::shared_ptr<std::iostream> stream, UploadLane lane)
+    {
+        if (!shaper.enabled())
+            return stream;
+        return std::make_shared<ThrottledStream>(std::move(stream), shaper, lane);
+    }
+
+    AlibabaCloud::OSS::ObjectMetaData OSSUploader::segmentMetaData(const Segment &segment) const
+    {
+        AlibabaCloud::OSS::ObjectMetaData metaData;
+        metaData.addUserHeader("sequence", std::to_string(segment.sequence)); // 对象名按上传时刻生成，按序号恢复采集顺序
+        metaData.addUserHeader("start-time", std::to_string(toMillis(segment.startTime)));
+        metaData.addUserHeader("end-time", std::to_string(toMillis(segment.endTime)));
+        metaData.addUserHeader("frame-count", std::to_string(segment.frameCount));
+        if (segment.headerBytes > 0)
+            metaData.addUserHeader("header-bytes", std::to_string(segment.headerBytes));
+        std::string index = segment.indexString();
+        if (!index.empty() && index.size() <= kMaxIndexMetaLength)
+            metaData.addUserHeader("keyframes", index);
+        if (segment.analyzedFrames > 0)
+        {
+            metaData.addUserHeader("motion-frames", std::to_string(segment.motionFrames));
+            metaData.addUserHeader("analyzed-frames", std::to_string(segment.analyzedFrames));
+            metaData.addUserHeader("motion-peak", std::to_string(segment.motionPeak));
+        }
+        return metaData;
+    }
+
+    void OSSUploader::executeUpload(const std::string &objectName, const std::shared_ptr<std::iostream> &stream,
+                                    const AlibabaCloud::OSS::ObjectMetaData &metaData)
     {
         std::cout << "[OSSUploader] used objectName: " << objectName << std::endl;
 
-        // 创建上传请求，指定存储桶、对象名称和文件流
-        AlibabaCloud::OSS::PutObjectRequest request(config.bucket, objectName, stream);
+        // 创建上传请求，指定存储桶、对象名称、文件流和元数据
+        AlibabaCloud::OSS::PutObjectRequest request(config.bucket, objectName, stream, metaData);
 
         // 执行上传请求
         auto outcome = client->PutObject(request);
@@ -77,40 +220,407 @@ namespace VideoStreamer
         }
     }
 
+    std::string OSSUploader::executeMultipartUpload(const Segment &segment, uint64_t fileSize, UploadLane lane)
+    {
+        const std::string &path = segment.path;
+        auto job = std::make_shared<MultipartJob>();
+        job->segment = segment;
+        job->lane = lane;
+        MultipartCheckpoint &checkpoint = job->checkpoint;
+
+        // 存在有效断点时沿用之前的对象名称和上传ID，否则发起新的分片上传
+        if (loadCheckpoint(path, fileSize, checkpoint))
+        {
+            std::cout << "[OSSUploader] 从断点恢复: " << checkpoint.objectName << "，已完成 "
+                      << checkpoint.parts.size() << " 个分片" << std::endl;
+        }
+        else
+        {
+            checkpoint = MultipartCheckpoint();
+            checkpoint.objectName = generateObjectName(segment);
+            checkpoint.fileSize = fileSize;
+            checkpoint.partSize = std::max<uint64_t>(config.multipartPartSize, 100 * 1024);
+
+            AlibabaCloud::OSS::InitiateMultipartUploadRequest request(config.bucket, checkpoint.objectName,
+                                                                      segmentMetaData(segment));
+            auto outcome = client->InitiateMultipartUpload(request);
+            if (!outcome.isSuccess())
+            {
+                throw std::runtime_error("[OSSUploader] OSS Error: " + outcome.error().Message());
+            }
+            checkpoint.uploadId = outcome.result().UploadId();
+            saveCheckpoint(path, checkpoint);
+        }
+        std::cout << "[OSSUploader] used objectName: " << checkpoint.objectName << std::endl;
+
+        // 找出尚未完成的分片
+        const int partCount = static_cast<int>((fileSize + checkpoint.partSize - 1) / checkpoint.partSize);
+        for (int partNumber = 1; partNumber <= partCount; ++partNumber)
+        {
+            if (!checkpoint.parts.count(partNumber))
+                job->missing.push_back(partNumber);
+        }
+
+        // 共享的分片线程和当前线程一起上传缺失的分片，每完成一个就追加到断点文件
+        // 分片线程都在忙于其他文件时，当前线程独自完成全部分片，不会等待分片线程
+        const size_t helpers = std::min(partThreads.size(), job->missing.empty() ? 0 : job->missing.size() - 1);
+        for (size_t i = 0; i < helpers; ++i)
+        {
+            partTasks.push([this, job]()
+                           { runParts(*job); });
+        }
+        runParts(*job);
+        {
+            // 等待其他线程已领取的分片完成；之后才执行的辅助任务领取不到分片，不会再访问断点
+            std::unique_lock<std::mutex> lock(job->mutex);
+            job->idle.wait(lock, [&]
+                           { return job->inFlight == 0; });
+        }
+
+        if (job->failed)
+        {
+            if (job->uploadExpired)
+                std::remove(checkpointPath(path).c_str()); // 上传ID已失效，下次重新发起
+            throw std::runtime_error(job->firstError);
+        }
+
+        // 按分片号顺序合并
+        AlibabaCloud::OSS::PartList partList;
+        for (const auto &part : checkpoint.parts)
+        {
+            partList.emplace_back(part.first, part.second);
+        }
+        AlibabaCloud::OSS::CompleteMultipartUploadRequest request(
+            config.bucket, checkpoint.objectName, partList, checkpoint.uploadId);
+        auto outcome = client->CompleteMultipartUpload(request);
+        if (!outcome.isSuccess())
+        {
+            if (outcome.error().Code() == "NoSuchUpload")
+                std::remove(checkpointPath(path).c_str());
+            throw std::runtime_error("[OSSUploader] OSS Error: " + outcome.error().Message());
+        }
+        std::remove(checkpointPath(path).c_str());
+        return checkpoint.objectName;
+    }
+
+    void OSSUploader::runParts(MultipartJob &job)
+    {
+        std::unique_lock<std::mutex> lock(job.mutex);
+        while (!job.failed && job.next < job.missing.size())
+        {
+            const int partNumber = job.missing[job.next++];
+            ++job.inFlight;
+            lock.unlock();
+
+            std::string etag, error;
+            bool uploaded = false, expired = false;
+            try
+            {
+                etag = uploadPart(job.checkpoint, job.segment, partNumber, job.lane);
+                uploaded = true;
+            }
+            catch (const std::exception &e)
+            {
+                error = e.what();
+                auto ossError = dynamic_cast<const OssError *>(&e);
+                expired = ossError && ossError->code == "NoSuchUpload";
+            }
+
+            lock.lock();
+            if (uploaded)
+            {
+                job.checkpoint.parts[partNumber] = etag;
+                appendCheckpointPart(job.segment.path, partNumber, etag);
+            }
+            else
+            {
+                if (!job.failed)
+                    job.firstError = error;
+                job.failed = true;
+                job.uploadExpired = job.uploadExpired || expired;
+            }
+            if (--job.inFlight == 0)
+                job.idle.notify_all();
+        }
+    }
+
+    void OSSUploader::appendManifest(const std::string &objectName, const Segment &segment)
+    {
+        // 清单按分段开始时刻（UTC）分小时：<前缀>manifest/YYYYMMDD/HH.jsonl
+        std::time_t start = std::chrono::system_clock::to_time_t(segment.startTime);
+        std::tm utc;
+        gmtime_r(&start, &utc);
+        char hour[32];
+        strftime(hour, sizeof(hour), "manifest/%Y%m%d/%H.jsonl", &utc);
+        const std::string manifestName =
+            (segment.objectPrefix.empty() ? config.uploadPrefix : segment.objectPrefix) + hour;
+
+        // 关键帧为[偏移, 相对start的毫秒]，播放工具从清单定位后用Range请求下载
+        std::ostringstream line;
+        line << "{\"object\":\"" << objectName << "\",\"sequence\":" << segment.sequence
+             << ",\"start\":" << toMillis(segment.startTime) << ",\"end\":" << toMillis(segment.endTime)
+             << ",\"frames\":" << segment.frameCount << ",\"bytes\":" << segment.bytes
+             << ",\"header\":" << segment.headerBytes << ",\"keyframes\":[";
+        for (size_t i = 0; i < segment.keyframes.size(); ++i)
+        {
+            const auto &entry = segment.keyframes[i];
+            line << (i ? "," : "") << "[" << entry.offset << ","
+                 << std::chrono::duration_cast<std::chrono::milliseconds>(entry.time - segment.startTime).count() << "]";
+        }
+        line << "]}\n";
+
+        // 本清单，以及其他还有待重试内容的清单（例如上一个小时追加失败的最后几行）
+        std::vector<std::pair<std::string, std::shared_ptr<ManifestState>>> targets;
+        {
+            std::lock_guard<std::mutex> lock(manifestsMutex);
+            auto &state = manifests[manifestName];
+            if (!state)
+                state = std::make_shared<ManifestState>();
+            {
+                std::lock_guard<std::mutex> pendingLock(state->pendingMutex);
+                state->pending += line.str();
+                state->retry = true;
+            }
+            targets.emplace_back(manifestName, state);
+            for (const auto &entry : manifests)
+            {
+                if (entry.first != manifestName && entry.second->retry)
+                    targets.push_back(entry);
+            }
+
+            // 淘汰最早的小时，待重试的清单保留到追加成功
+            for (auto it = manifests.begin(); manifests.size() > kMaxManifests && it != manifests.end();)
+            {
+                if (it->first != manifestName && !it->second->retry)
+                    it = manifests.erase(it);
+                else
+                    ++it;
+            }
+        }
+
+        for (const auto &target : targets)
+        {
+            flushManifest(target.first, *target.second);
+        }
+    }
+
+    void OSSUploader::flushManifest(const std::string &manifestName, ManifestState &state)
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        std::string content;
+        {
+            std::lock_guard<std::mutex> pendingLock(state.pendingMutex);
+            content.swap(state.pending);
+        }
+        if (content.empty())
+            return;
+
+        bool appended = false;
+        try
+        {
+            appendObject(manifestName, state.position, content);
+            appended = true;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "[OSSUploader] 清单追加失败: " << manifestName << ": " << e.what() << std::endl;
+        }
+
+        std::lock_guard<std::mutex> pendingLock(state.pendingMutex);
+        if (!appended)
+        {
+            // 失败的行放在追加期间新加入的行之前，保持清单内的先后顺序
+            state.pending.insert(0, content);
+            if (state.pending.size() > kMaxManifestPending)
+            {
+                std::cerr << "[OSSUploader] 清单待重试内容超过上限，丢弃 " << state.pending.size()
+                          << " 字节: " << manifestName << std::endl;
+                state.pending.clear();
+            }
+        }
+        state.retry = !state.pending.empty();
+    }
+
+    void OSSUploader::appendObject(const std::string &objectName, uint64_t &position, const std::string &content)
+    {
+        for (int attempt = 0; attempt < 2; ++attempt)
+        {
+            auto stream = std::make_shared<std::stringstream>(content, std::ios::in | std::ios::out | std::ios::binary);
+            AlibabaCloud::OSS::AppendObjectRequest request(config.bucket, objectName, stream);
+            request.setPosition(position);
+            auto outcome = client->AppendObject(request);
+            if (outcome.isSuccess())
+            {
+                position = outcome.result().Length();
+                return;
+            }
+            if (outcome.error().Code() != "PositionNotEqualToLength" || attempt > 0)
+            {
+                throw std::runtime_error("[OSSUploader] OSS Error: " + outcome.error().Message());
+            }
+
+            // 对象已存在（例如进程重启后继续写同一小时的清单），按实际长度继续追加
+            auto head = client->HeadObject(config.bucket, objectName);
+            if (!head.isSuccess())
+            {
+                throw std::runtime_error("[OSSUploader] OSS Error: " + head.error().Message());
+            }
+            position = static_cast<uint64_t>(head.result().ContentLength());
+        }
+    }
+
+    std::string OSSUploader::uploadPart(const MultipartCheckpoint &checkpoint, const Segment &segment, int partNumber,
+                                        UploadLane lane)
+    {
+        const uint64_t offset = static_cast<uint64_t>(partNumber - 1) * checkpoint.partSize;
+        const uint64_t size = std::min(checkpoint.partSize, checkpoint.fileSize - offset);
+
+        std::shared_ptr<std::iostream> content;
+        if (segment.inMemory())
+        {
+            content = std::make_shared<MemoryStream>(segment.data, offset, size);
+        }
+        else
+        {
+            // 每个分片独立读取，避免多个线程共享同一个文件流
+            std::ifstream in(segment.path, std::ios::in | std::ios::binary);
+            std::string buffer(size, '\0');
+            in.seekg(offset);
+            if (!in.read(&buffer[0], size))
+            {
+                throw std::runtime_error("[OSSUploader] 分片读取失败: " + segment.path);
+            }
+            content = std::make_shared<std::stringstream>(
+                std::move(buffer), std::ios::in | std::ios::out | std::ios::binary);
+        }
+
+        AlibabaCloud::OSS::UploadPartRequest request(
+            config.bucket, checkpoint.objectName, partNumber, checkpoint.uploadId, throttle(content, lane));
+        request.setContentLength(size);
+        auto outcome = client->UploadPart(request);
+        if (!outcome.isSuccess())
+        {
+            throw OssError(outcome.error().Code(), outcome.error().Message());
+        }
+        return outcome.result().ETag();
+    }
+
+    bool OSSUploader::loadCheckpoint(const std::string &path, uint64_t fileSize, MultipartCheckpoint &checkpoint)
+    {
+        std::ifstream in(checkpointPath(path));
+        if (!in.is_open())
+            return false;
+
+        std::string key;
+        while (in >> key)
+        {
+            if (key == "object")
+                in >> checkpoint.objectName;
+            else if (key == "upload")
+                in >> checkpoint.uploadId;
+            else if (key == "size")
+                in >> checkpoint.fileSize;
+            else if (key == "part_size")
+                in >> checkpoint.partSize;
+            else if (key == "part")
+            {
+                int partNumber = 0;
+                std::string etag;
+                if (in >> partNumber >> etag) // 最后一行可能因崩溃而不完整，忽略即可
+                    checkpoint.parts[partNumber] = etag;
+            }
+        }
+
+        // 文件被改写或记录不完整时断点无效
+        return !checkpoint.objectName.empty() && !checkpoint.uploadId.empty() &&
+               checkpoint.fileSize == fileSize && checkpoint.partSize > 0;
+    }
+
+    void OSSUploader::saveCheckpoint(const std::string &path, const MultipartCheckpoint &checkpoint)
+    {
+        std::ofstream out(checkpointPath(path), std::ios::trunc);
+        out << "object " << checkpoint.objectName << "\n"
+            << "upload " << checkpoint.uploadId << "\n"
+            << "size " << checkpoint.fileSize << "\n"
+            << "part_size " << checkpoint.partSize << "\n";
+        for (const auto &part : checkpoint.parts)
+        {
+            out << "part " << part.first << " " << part.second << "\n";
+        }
+    }
+
+    void OSSUploader::appendCheckpointPart(const std::string &path, int partNumber, const std::string &etag)
+    {
+        std::ofstream out(checkpointPath(path), std::ios::app);
+        out << "part " << partNumber << " " << etag << std::endl;
+    }
+
     void OSSUploader::cleanupFile(const std::string &path)
     {
         // 删除本地文件
         std::remove(path.c_str());
     }
 
-    void OSSUploader::uploadFile(const std::string &filePath)
+    bool OSSUploader::uploadSegment(const Segment &segment, UploadLane lane)
     {
-        // 检查文件是否存在
-        if (!validateFile(filePath))
+        const std::string &filePath = segment.path;
+
+        uint64_t fileSize = 0;
+        if (segment.inMemory())
         {
-            std::cerr << "[OSSUploader] 文件不存在: " << filePath << std::endl; // 如果文件不存在，输出错误信息
-            return;
+            fileSize = segment.data->size();
+        }
+        else
+        {
+            // 检查文件是否存在
+            struct stat statBuf;
+            if (!validateFile(filePath) || stat(filePath.c_str(), &statBuf) != 0)
+            {
+                std::cerr << "[OSSUploader] 文件不存在: " << filePath << std::endl; // 如果文件不存在，输出错误信息
+                return false;
+            }
+            fileSize = static_cast<uint64_t>(statBuf.st_size);
         }
 
         try
         {
-            // 生成上传对象的名称
-            auto objectName = generateObjectName();
+            std::string objectName;
+            if (config.multipartThreshold > 0 && fileSize >= config.multipartThreshold)
+            {
+                // 大文件使用分片上传，失败后再次上传时从断点继续
+                objectName = executeMultipartUpload(segment, fileSize, lane);
+            }
+            else
+            {
+                // 生成上传对象的名称
+                objectName = generateObjectName(segment);
 
-            // 打开文件流
-            auto fileStream = openFileStream(filePath);
+                // 内存分段直接引用编码器输出缓冲，文件分段打开文件流
+                std::shared_ptr<std::iostream> stream;
+                if (segment.inMemory())
+                    stream = std::make_shared<MemoryStream>(segment.data);
+                else
+                    stream = openFileStream(filePath);
 
-            // 执行文件上传
-            executeUpload(objectName, fileStream);
+                // 执行文件上传
+                executeUpload(objectName, throttle(stream, lane), segmentMetaData(segment));
+            }
+            if (config.segmentManifest)
+                appendManifest(objectName, segment);
 
-            // 上传完成后删除本地文件
-            cleanupFile(filePath);
-            std::cout << "[OSSUploader] 上传成功后删除本地文件：" << filePath << std::endl;
+            if (!segment.inMemory())
+            {
+                // 上传完成后删除本地文件
+                cleanupFile(filePath);
+                std::cout << "[OSSUploader] 上传成功后删除本地文件：" << filePath << std::endl;
+            }
+            return true;
         }
         catch (const std::exception &e)
         {
             // 捕获并输出上传过程中的错误
             std::cerr << "[OSSUploader] 上传失败: " << e.what() << std::endl;
+            return false;
         }
     }
-} // namespace VideoStreamer
\ No newline at end of file
+} // namespace VideoStreamer
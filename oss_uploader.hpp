@@ -1,21 +1,70 @@
 #pragma once
+#include "bandwidth_shaper.hpp"
 #include "config.hpp"
+#include "segment.hpp"
+#include "thread_safe_queue.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace VideoStreamer
 {
+    /**
+     * 分片上传的断点记录，保存在本地文件旁的 .ucp 文件中
+     * 重试时只上传尚未完成的分片
+     */
+    struct MultipartCheckpoint
+    {
+        std::string objectName;       // 对象名称
+        std::string uploadId;         // OSS分配的分片上传ID
+        uint64_t fileSize = 0;        // 文件大小，用于判断断点是否仍然有效
+        uint64_t partSize = 0;        // 分片大小
+        std::map<int, std::string> parts; // 已完成的分片号 -> ETag
+    };
+
     /**
      * OSSUploader类用于将文件上传到阿里云OSS
+     * 小文件使用单次PutObject；超过阈值的文件使用分片上传，分片并发发送并记录断点
+     * 一个实例可被多个线程共享：所有请求复用同一个OssClient的连接池（uploadConnections）和TLS会话；
+     * 异步接口把上传交给固定数量（uploadThreads）的请求线程执行，而不是每个请求一个线程；
+     * 分片上传的辅助线程（multipartParallelism-1个）由所有分片上传共享，与请求线程分开，
+     * 请求线程等待分片完成时不会占住执行分片的线程；
+     * 配置了上传带宽上限时，所有请求的发送数据经同一个BandwidthShaper限速，积压通道只使用剩余带宽
      */
     class OSSUploader
     {
     public:
+        // 异步上传完成回调（在请求线程上调用）
+        using UploadCallback = std::function<void(const Segment &, bool)>;
+
         explicit OSSUploader(const AppConfig &cfg);
+        ~OSSUploader();
+
+        OSSUploader(const OSSUploader &) = delete;
+        OSSUploader &operator=(const OSSUploader &) = delete;
+
+        /**
+         * 上传分段文件（阻塞），上传成功返回true；lane决定限速时的优先级
+         */
+        bool uploadSegment(const Segment &segment, UploadLane lane = UploadLane::Live);
+
+        /**
+         * 异步上传分段：立即返回future，完成后（若提供）调用callback
+         */
+        std::future<bool> uploadSegmentAsync(const Segment &segment, UploadCallback callback = nullptr,
+                                             UploadLane lane = UploadLane::Live);
+
         /**
-         * 上传文件的接口，传入文件路径
+         * 共享的上传限速器（用于统计）
          */
-        void uploadFile(const std::string &filePath);
+        const BandwidthShaper &bandwidth() const { return shaper; }
 
     private:
         /**
@@ -23,6 +72,11 @@ namespace VideoStreamer
          */
         void initClient();
 
+        /**
+         * 请求线程/分片线程主循环：依次执行队列中的任务
+         */
+        void requestLoop(ThreadSafeQueue<std::function<void()>> &tasks);
+
         /**
          * 验证文件是否存在
          */
@@ -31,17 +85,90 @@ namespace VideoStreamer
         /**
          * 生成上传到OSS的对象名称
          */
-        std::string generateObjectName();
+        std::string generateObjectName(const Segment &segment);
 
         /**
          * 打开文件并返回文件流
          */
         std::shared_ptr<std::iostream> openFileStream(const std::string &path);
 
+        /**
+         * 启用限速时用ThrottledStream包装上传内容，否则原样返回
+         */
+        std::shared_ptr<std::iostream> throttle(std::shared_ptr<std::iostream> stream, UploadLane lane);
+
+        /**
+         * 分段的对象元数据：分段序号、时间范围、关键帧索引和活动信息写入x-oss-meta-*用户元数据，
+         * 便于排序、按时间定位和按活动筛选录像
+         */
+        AlibabaCloud::OSS::ObjectMetaData segmentMetaData(const Segment &segment) const;
+
         /**
          * 执行文件上传操作
          */
-        void executeUpload(const std::string &objectName, const std::shared_ptr<std::iostream> &stream);
+        void executeUpload(const std::string &objectName, const std::shared_ptr<std::iostream> &stream,
+                           const AlibabaCloud::OSS::ObjectMetaData &metaData);
+
+        /**
+         * 执行分片上传：从断点恢复（若有），并发上传缺失的分片后合并，返回对象名称
+         */
+        std::string executeMultipartUpload(const Segment &segment, uint64_t fileSize, UploadLane lane);
+
+        /**
+         * 把分段的索引（对象名、时间范围、帧数、关键帧偏移）作为一行JSON追加到分段开始时刻所在小时的清单对象
+         * 清单是OSS追加类型的对象，追加失败的行留在内存中，随同一清单或其他清单的下一次追加重试，
+         * 不影响分段本身的上传结果
+         */
+        void appendManifest(const std::string &objectName, const Segment &segment);
+
+        // 一个清单对象的追加状态
+        struct ManifestState
+        {
+            std::mutex mutex;               // 同一对象的追加必须串行，不同对象互不等待（追加期间一直持有）
+            uint64_t position = 0;          // 下一个追加位置
+            std::mutex pendingMutex;        // 只保护pending，持有时间很短
+            std::string pending;            // 等待追加的行（追加失败的行放回这里）
+            std::atomic<bool> retry{false}; // 有等待追加或正在追加的行，为true时不会被淘汰
+        };
+
+        /**
+         * 把清单尚未追加的行一次追加到对象末尾，失败时保留这些行等待下次重试
+         */
+        void flushManifest(const std::string &manifestName, ManifestState &state);
+
+        /**
+         * 向追加类型的对象末尾追加内容（调用方持有该对象的锁），位置与本地记录不一致时按对象实际长度重试一次
+         */
+        void appendObject(const std::string &objectName, uint64_t &position, const std::string &content);
+
+        // 一次分片上传中各线程共享的状态（定义在实现文件中）
+        struct MultipartJob;
+
+        /**
+         * 领取并上传分片，直到分片领取完或有分片失败；调用线程和分片线程都执行这个函数
+         */
+        void runParts(MultipartJob &job);
+
+        /**
+         * 上传单个分片，返回ETag（内存分段直接引用缓冲，文件分段按偏移读取）
+         */
+        std::string uploadPart(const MultipartCheckpoint &checkpoint, const Segment &segment, int partNumber,
+                               UploadLane lane);
+
+        /**
+         * 读取断点文件，不存在或与当前文件不匹配时返回false
+         */
+        bool loadCheckpoint(const std::string &path, uint64_t fileSize, MultipartCheckpoint &checkpoint);
+
+        /**
+         * 写入断点头部（对象名称、上传ID、文件/分片大小）
+         */
+        void saveCheckpoint(const std::string &path, const MultipartCheckpoint &checkpoint);
+
+        /**
+         * 向断点文件追加一条已完成的分片记录
+         */
+        void appendCheckpointPart(const std::string &path, int partNumber, const std::string &etag);
 
         /**
          * 删除本地文件
@@ -51,7 +178,22 @@ namespace VideoStreamer
         // 存储应用程序的配置
         AppConfig config;
 
-        // OSS客户端，负责与阿里云OSS进行交互
+        // OSS客户端，负责与阿里云OSS进行交互（线程安全，所有请求共享）
         std::shared_ptr<AlibabaCloud::OSS::OssClient> client;
+
+        // 所有请求共享的上传限速器
+        BandwidthShaper shaper;
+
+        // 各清单对象的追加状态，manifestsMutex只保护映射本身，追加时持有对象各自的锁
+        std::mutex manifestsMutex;
+        std::map<std::string, std::shared_ptr<ManifestState>> manifests;
+
+        // 异步上传任务队列及执行这些任务的请求线程
+        ThreadSafeQueue<std::function<void()>> requests;
+        std::vector<std::thread> requestThreads;
+
+        // 分片上传的辅助任务队列及共享的分片线程
+        ThreadSafeQueue<std::function<void()>> partTasks;
+        std::vector<std::thread> partThreads;
     };
 } // namespace VideoStreamer
\ No newline at end of file
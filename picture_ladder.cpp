@@ -0,0 +1,241 @@
+#include "picture_ladder.hpp"
+#include "pixel_convert.hpp"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace VideoStreamer
+{
+    namespace
+    {
+        // 将FFmpeg错误码转换为可读字符串
+        std::string avError(int code)
+        {
+            char buf[AV_ERROR_MAX_STRING_SIZE] = {0};
+            av_strerror(code, buf, sizeof(buf));
+            return buf;
+        }
+
+        // 准备写入一帧画面：尺寸/格式不符，或缓冲仍被编码器引用时重新分配（随后整帧覆盖，不复制旧内容）
+        void prepareBuffer(AVFrame *&frame, int width, int height, AVPixelFormat format)
+        {
+            if (frame && frame->width == width && frame->height == height && frame->format == format &&
+                av_frame_is_writable(frame))
+                return;
+
+            if (!frame)
+                frame = av_frame_alloc();
+            else
+                av_frame_unref(frame);
+            if (!frame)
+            {
+                throw std::runtime_error("[PictureLadder] 内存分配失败");
+            }
+            frame->format = format;
+            frame->width = width;
+            frame->height = height;
+            int ret = av_frame_get_buffer(frame, 0);
+            if (ret < 0)
+            {
+                throw std::runtime_error("[PictureLadder] 画面缓冲分配失败: " + avError(ret));
+            }
+        }
+
+        // 等比例计算出的一边取偶数（4:2:0/4:2:2的色度按2像素采样）
+        int evenDimension(int64_t value)
+        {
+            return static_cast<int>(std::max<int64_t>((value + 1) / 2 * 2, 2));
+        }
+    } // namespace
+
+    std::vector<Rendition> resolveRenditions(const AppConfig &cfg)
+    {
+        std::vector<Rendition> renditions = cfg.renditions;
+        if (renditions.empty())
+            renditions.emplace_back();
+        for (size_t i = 0; i < renditions.size(); ++i)
+        {
+            if (renditions[i].bitRate <= 0)
+                renditions[i].bitRate = cfg.bitRate;
+            if (renditions[i].name.empty() && renditions.size() > 1)
+                renditions[i].name = "r" + std::to_string(i); // 本地文件名按档位区分
+        }
+        return renditions;
+    }
+
+    int64_t renditionBitRate(const Rendition &rendition, int64_t bitRate, int64_t baseBitRate)
+    {
+        if (baseBitRate <= 0 || bitRate == baseBitRate)
+            return rendition.bitRate;
+        return std::max<int64_t>(rendition.bitRate * bitRate / baseBitRate, 1);
+    }
+
+    PictureLadder::PictureLadder()
+    {
+        packet = av_packet_alloc();
+        decodedFrame = av_frame_alloc();
+        if (!packet || !decodedFrame)
+        {
+            throw std::runtime_error("[PictureLadder] 内存分配失败");
+        }
+
+        const AVCodec *decoder = avcodec_find_decoder(AV_CODEC_ID_MJPEG);
+        if (!decoder)
+        {
+            throw std::runtime_error("[PictureLadder] 未找到MJPEG解码器");
+        }
+        decoderCtx = avcodec_alloc_context3(decoder);
+        int ret = avcodec_open2(decoderCtx, decoder, nullptr);
+        if (ret < 0)
+        {
+            throw std::runtime_error("[PictureLadder] MJPEG解码器打开失败: " + avError(ret));
+        }
+    }
+
+    PictureLadder::~PictureLadder()
+    {
+        for (auto &entry : scaled)
+        {
+            av_frame_free(&entry.frame);
+            sws_freeContext(entry.swsCtx);
+        }
+        sws_freeContext(convertCtx);
+        av_frame_free(&source);
+        avcodec_free_context(&decoderCtx);
+        av_frame_free(&decodedFrame);
+        av_packet_free(&packet);
+    }
+
+    bool PictureLadder::load(const Frame &frame)
+    {
+        loaded = false;
+        for (auto &entry : scaled)
+            entry.ready = false;
+        loaded = isRawFormat(frame.format) ? convertRaw(frame) : decodeJpeg(frame);
+        return loaded;
+    }
+
+    bool PictureLadder::decodeJpeg(const Frame &frame)
+    {
+        packet->data = const_cast<uint8_t *>(frame.data());
+        packet->size = static_cast<int>(frame.dataSize());
+        int ret = avcodec_send_packet(decoderCtx, packet);
+        packet->data = nullptr;
+        packet->size = 0;
+        if (ret < 0)
+        {
+            std::cerr << "[PictureLadder] JPEG解码失败: " << avError(ret) << std::endl;
+            return false;
+        }
+
+        ret = avcodec_receive_frame(decoderCtx, decodedFrame);
+        if (ret < 0)
+        {
+            std::cerr << "[PictureLadder] JPEG解码失败: " << avError(ret) << std::endl;
+            return false;
+        }
+
+        // 转换像素格式（yuvj422p -> yuv422p）
+        prepareBuffer(source, decodedFrame->width, decodedFrame->height, AV_PIX_FMT_YUV422P);
+        convertCtx = sws_getCachedContext(convertCtx,
+                                          decodedFrame->width, decodedFrame->height,
+                                          static_cast<AVPixelFormat>(decodedFrame->format),
+                                          source->width, source->height, AV_PIX_FMT_YUV422P,
+                                          SWS_BILINEAR, nullptr, nullptr, nullptr);
+        sws_scale(convertCtx, decodedFrame->data, decodedFrame->linesize, 0, decodedFrame->height,
+                  source->data, source->linesize);
+        av_frame_unref(decodedFrame);
+        return true;
+    }
+
+    bool PictureLadder::convertRaw(const Frame &frame)
+    {
+        const int width = static_cast<int>(frame.width);
+        const int height = static_cast<int>(frame.height);
+        const size_t expected = rawFrameSize(frame.format, width, height);
+        if (expected == 0 || frame.dataSize() < expected)
+        {
+            std::cerr << "[PictureLadder] 未压缩帧大小不符: " << frame.dataSize() << "，应为 " << expected << std::endl;
+            return false;
+        }
+
+        prepareBuffer(source, width, height, AV_PIX_FMT_YUV420P);
+        const uint8_t *data = frame.data();
+        if (frame.format == OB_FORMAT_YUYV)
+        {
+            yuyvToI420(data, width * 2, width, height,
+                       source->data[0], source->linesize[0],
+                       source->data[1], source->linesize[1],
+                       source->data[2], source->linesize[2]);
+        }
+        else
+        {
+            nv12ToI420(data, width, data + static_cast<size_t>(width) * height, (width + 1) / 2 * 2, width, height,
+                       source->data[0], source->linesize[0],
+                       source->data[1], source->linesize[1],
+                       source->data[2], source->linesize[2]);
+        }
+        return true;
+    }
+
+    void PictureLadder::resolveSize(int &width, int &height) const
+    {
+        if (width <= 0 && height <= 0)
+        {
+            width = source->width;
+            height = source->height;
+        }
+        else if (width <= 0)
+        {
+            width = evenDimension(static_cast<int64_t>(source->width) * height / source->height);
+        }
+        else if (height <= 0)
+        {
+            height = evenDimension(static_cast<int64_t>(source->height) * width / source->width);
+        }
+    }
+
+    const AVFrame *PictureLadder::picture(int width, int height)
+    {
+        if (!loaded)
+            return nullptr;
+
+        resolveSize(width, height);
+        if (width == source->width && height == source->height)
+            return source;
+
+        Scaled *entry = nullptr;
+        for (auto &candidate : scaled)
+        {
+            if (candidate.width == width && candidate.height == height)
+                entry = &candidate;
+        }
+        if (!entry)
+        {
+            scaled.emplace_back();
+            entry = &scaled.back();
+            entry->width = width;
+            entry->height = height;
+        }
+        if (entry->ready)
+            return entry->frame;
+
+        // 从本帧已缩放的画面中选不小于目标的最小一个继续缩放（例如360p取自720p），没有时从源画面缩放
+        const AVFrame *from = source;
+        for (const auto &other : scaled)
+        {
+            if (other.ready && other.width >= width && other.height >= height &&
+                static_cast<int64_t>(other.width) * other.height < static_cast<int64_t>(from->width) * from->height)
+                from = other.frame;
+        }
+
+        const AVPixelFormat format = static_cast<AVPixelFormat>(source->format);
+        prepareBuffer(entry->frame, width, height, format);
+        entry->swsCtx = sws_getCachedContext(entry->swsCtx, from->width, from->height, format,
+                                             width, height, format, SWS_BILINEAR, nullptr, nullptr, nullptr);
+        sws_scale(entry->swsCtx, from->data, from->linesize, 0, from->height,
+                  entry->frame->data, entry->frame->linesize);
+        entry->ready = true;
+        return entry->frame;
+    }
+} // namespace VideoStreamer
@@ -0,0 +1,86 @@
+#pragma once
+#include "config.hpp"
+#include "frame.hpp"
+#include <cstdint>
+#include <vector>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+namespace VideoStreamer
+{
+    /**
+     * 编码阶梯的档位列表：renditions为空时返回一个采集分辨率、bitRate的档位；
+     * 未填写码率的档位使用bitRate，有多个档位时未命名的档位命名为r0、r1…
+     */
+    std::vector<Rendition> resolveRenditions(const AppConfig &cfg);
+
+    /**
+     * 自适应码率下档位的当前码率：档位码率按当前主码率bitRate与配置的baseBitRate之比缩放
+     */
+    int64_t renditionBitRate(const Rendition &rendition, int64_t bitRate, int64_t baseBitRate);
+
+    /**
+     * PictureLadder类，编码输入画面的单次解码与多尺寸缩放
+     * 每帧只做一次JPEG解码（或YUYV/NV12转换）得到源画面；各输出尺寸的缩放结果在同一帧内共享：
+     * 尺寸相同的档位共用一个缓冲，较小的尺寸从已缩放的最接近的较大画面继续缩放，而不是每次都从源画面缩放
+     * 画面缓冲带引用计数，下一帧写入前若仍被编码器引用则重新分配，不会改写编码器持有的数据
+     */
+    class PictureLadder
+    {
+    public:
+        PictureLadder();
+        ~PictureLadder();
+
+        PictureLadder(const PictureLadder &) = delete;
+        PictureLadder &operator=(const PictureLadder &) = delete;
+
+        /**
+         * 解码（MJPEG）或转换（YUYV/NV12）一帧作为源画面，之前取得的画面随之作废；失败返回false
+         */
+        bool load(const Frame &frame);
+
+        /**
+         * 当前帧指定尺寸的画面（0的含义与Rendition相同），同一帧内第一次请求该尺寸时缩放；
+         * 没有成功load的帧时返回nullptr
+         */
+        const AVFrame *picture(int width, int height);
+
+    private:
+        /**
+         * 解码JPEG数据并转换为yuv422p源画面，成功返回true
+         */
+        bool decodeJpeg(const Frame &frame);
+
+        /**
+         * 把未压缩帧转换为I420源画面，数据大小不符时返回false
+         */
+        bool convertRaw(const Frame &frame);
+
+        /**
+         * 按源画面尺寸解析输出尺寸（等比例计算的一边取偶数）
+         */
+        void resolveSize(int &width, int &height) const;
+
+        // 一个输出尺寸的缩放缓冲
+        struct Scaled
+        {
+            int width = 0;
+            int height = 0;
+            AVFrame *frame = nullptr;     // 缩放结果（像素格式与源画面相同）
+            SwsContext *swsCtx = nullptr; // 缩放上下文
+            bool ready = false;           // 当前帧是否已缩放
+        };
+
+        AVCodecContext *decoderCtx = nullptr; // MJPEG解码器上下文
+        AVPacket *packet = nullptr;           // 复用的数据包
+        AVFrame *decodedFrame = nullptr;      // 解码输出帧
+        AVFrame *source = nullptr;            // 源画面（MJPEG输入为yuv422p，未压缩输入为yuv420p）
+        SwsContext *convertCtx = nullptr;     // 解码输出的像素格式转换（yuvj422p -> yuv422p）
+        std::vector<Scaled> scaled;           // 各输出尺寸的缩放缓冲
+        bool loaded = false;                  // 当前帧是否已成功加载
+    };
+} // namespace VideoStreamer
@@ -0,0 +1,228 @@
+#include "pixel_convert.hpp"
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace VideoStreamer
+{
+    namespace
+    {
+        /**
+         * 转换YUYV的一对行：row1为nullptr表示只有一行（奇数高度的最后一行），此时y1不写入
+         */
+        void yuyvRowPair(const uint8_t *row0, const uint8_t *row1, int width,
+                         uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v)
+        {
+            const uint8_t *chroma1 = row1 ? row1 : row0;
+            int x = 0;
+#if defined(__AVX2__)
+            // 每次64个像素（每行128字节）：16位掩码取偶数字节为亮度，右移8位取奇数字节为UV；
+            // packus按128位通道交错，permute4x64恢复顺序
+            const __m256i mask = _mm256_set1_epi16(0x00FF);
+            auto pack = [](__m256i a, __m256i b)
+            { return _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8); };
+            for (; x + 64 <= width; x += 64)
+            {
+                const __m256i *p0 = reinterpret_cast<const __m256i *>(row0 + x * 2);
+                const __m256i *p1 = reinterpret_cast<const __m256i *>(chroma1 + x * 2);
+                __m256i a0 = _mm256_loadu_si256(p0), b0 = _mm256_loadu_si256(p0 + 1);
+                __m256i c0 = _mm256_loadu_si256(p0 + 2), d0 = _mm256_loadu_si256(p0 + 3);
+                __m256i a1 = _mm256_loadu_si256(p1), b1 = _mm256_loadu_si256(p1 + 1);
+                __m256i c1 = _mm256_loadu_si256(p1 + 2), d1 = _mm256_loadu_si256(p1 + 3);
+
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(y0 + x),
+                                    pack(_mm256_and_si256(a0, mask), _mm256_and_si256(b0, mask)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(y0 + x + 32),
+                                    pack(_mm256_and_si256(c0, mask), _mm256_and_si256(d0, mask)));
+                if (row1)
+                {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(y1 + x),
+                                        pack(_mm256_and_si256(a1, mask), _mm256_and_si256(b1, mask)));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(y1 + x + 32),
+                                        pack(_mm256_and_si256(c1, mask), _mm256_and_si256(d1, mask)));
+                }
+
+                __m256i uvA = _mm256_avg_epu8(pack(_mm256_srli_epi16(a0, 8), _mm256_srli_epi16(b0, 8)),
+                                              pack(_mm256_srli_epi16(a1, 8), _mm256_srli_epi16(b1, 8)));
+                __m256i uvB = _mm256_avg_epu8(pack(_mm256_srli_epi16(c0, 8), _mm256_srli_epi16(d0, 8)),
+                                              pack(_mm256_srli_epi16(c1, 8), _mm256_srli_epi16(d1, 8)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(u + x / 2),
+                                    pack(_mm256_and_si256(uvA, mask), _mm256_and_si256(uvB, mask)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(v + x / 2),
+                                    pack(_mm256_srli_epi16(uvA, 8), _mm256_srli_epi16(uvB, 8)));
+            }
+#elif defined(__SSE2__)
+            // 每次32个像素（每行64字节）
+            const __m128i mask = _mm_set1_epi16(0x00FF);
+            for (; x + 32 <= width; x += 32)
+            {
+                const __m128i *p0 = reinterpret_cast<const __m128i *>(row0 + x * 2);
+                const __m128i *p1 = reinterpret_cast<const __m128i *>(chroma1 + x * 2);
+                __m128i a0 = _mm_loadu_si128(p0), b0 = _mm_loadu_si128(p0 + 1);
+                __m128i c0 = _mm_loadu_si128(p0 + 2), d0 = _mm_loadu_si128(p0 + 3);
+                __m128i a1 = _mm_loadu_si128(p1), b1 = _mm_loadu_si128(p1 + 1);
+                __m128i c1 = _mm_loadu_si128(p1 + 2), d1 = _mm_loadu_si128(p1 + 3);
+
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(y0 + x),
+                                 _mm_packus_epi16(_mm_and_si128(a0, mask), _mm_and_si128(b0, mask)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(y0 + x + 16),
+                                 _mm_packus_epi16(_mm_and_si128(c0, mask), _mm_and_si128(d0, mask)));
+                if (row1)
+                {
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(y1 + x),
+                                     _mm_packus_epi16(_mm_and_si128(a1, mask), _mm_and_si128(b1, mask)));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(y1 + x + 16),
+                                     _mm_packus_epi16(_mm_and_si128(c1, mask), _mm_and_si128(d1, mask)));
+                }
+
+                __m128i uvA = _mm_avg_epu8(_mm_packus_epi16(_mm_srli_epi16(a0, 8), _mm_srli_epi16(b0, 8)),
+                                           _mm_packus_epi16(_mm_srli_epi16(a1, 8), _mm_srli_epi16(b1, 8)));
+                __m128i uvB = _mm_avg_epu8(_mm_packus_epi16(_mm_srli_epi16(c0, 8), _mm_srli_epi16(d0, 8)),
+                                           _mm_packus_epi16(_mm_srli_epi16(c1, 8), _mm_srli_epi16(d1, 8)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(u + x / 2),
+                                 _mm_packus_epi16(_mm_and_si128(uvA, mask), _mm_and_si128(uvB, mask)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(v + x / 2),
+                                 _mm_packus_epi16(_mm_srli_epi16(uvA, 8), _mm_srli_epi16(uvB, 8)));
+            }
+#elif defined(__ARM_NEON)
+            // 每次32个像素：vld4按Y0/U/Y1/V四路拆开，vst2把两路亮度交织回原顺序
+            for (; x + 32 <= width; x += 32)
+            {
+                uint8x16x4_t p0 = vld4q_u8(row0 + x * 2);
+                uint8x16x4_t p1 = vld4q_u8(chroma1 + x * 2);
+                uint8x16x2_t luma0 = {{p0.val[0], p0.val[2]}};
+                vst2q_u8(y0 + x, luma0);
+                if (row1)
+                {
+                    uint8x16x2_t luma1 = {{p1.val[0], p1.val[2]}};
+                    vst2q_u8(y1 + x, luma1);
+                }
+                vst1q_u8(u + x / 2, vrhaddq_u8(p0.val[1], p1.val[1]));
+                vst1q_u8(v + x / 2, vrhaddq_u8(p0.val[3], p1.val[3]));
+            }
+#endif
+            for (; x + 1 < width; x += 2)
+            {
+                const uint8_t *p0 = row0 + x * 2;
+                const uint8_t *p1 = chroma1 + x * 2;
+                y0[x] = p0[0];
+                y0[x + 1] = p0[2];
+                if (row1)
+                {
+                    y1[x] = p1[0];
+                    y1[x + 1] = p1[2];
+                }
+                u[x / 2] = static_cast<uint8_t>((p0[1] + p1[1] + 1) >> 1);
+                v[x / 2] = static_cast<uint8_t>((p0[3] + p1[3] + 1) >> 1);
+            }
+        }
+
+        /**
+         * 拆分一行交织的UV（pairs个UV对）
+         */
+        void splitUV(const uint8_t *uv, int pairs, uint8_t *u, uint8_t *v)
+        {
+            int i = 0;
+#if defined(__AVX2__)
+            const __m256i mask = _mm256_set1_epi16(0x00FF);
+            for (; i + 32 <= pairs; i += 32)
+            {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(uv + i * 2));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(uv + i * 2 + 32));
+                __m256i us = _mm256_packus_epi16(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+                __m256i vs = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(u + i), _mm256_permute4x64_epi64(us, 0xD8));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(v + i), _mm256_permute4x64_epi64(vs, 0xD8));
+            }
+#elif defined(__SSE2__)
+            const __m128i mask = _mm_set1_epi16(0x00FF);
+            for (; i + 16 <= pairs; i += 16)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(uv + i * 2));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(uv + i * 2 + 16));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(u + i),
+                                 _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(v + i),
+                                 _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+            }
+#elif defined(__ARM_NEON)
+            for (; i + 16 <= pairs; i += 16)
+            {
+                uint8x16x2_t p = vld2q_u8(uv + i * 2);
+                vst1q_u8(u + i, p.val[0]);
+                vst1q_u8(v + i, p.val[1]);
+            }
+#endif
+            for (; i < pairs; ++i)
+            {
+                u[i] = uv[i * 2];
+                v[i] = uv[i * 2 + 1];
+            }
+        }
+    } // namespace
+
+    bool isRawFormat(ob_format format)
+    {
+        return format == OB_FORMAT_YUYV || format == OB_FORMAT_NV12;
+    }
+
+    size_t rawFrameSize(ob_format format, int width, int height)
+    {
+        const size_t pixels = static_cast<size_t>(width) * height;
+        if (format == OB_FORMAT_YUYV)
+            return pixels * 2;
+        if (format == OB_FORMAT_NV12)
+            return pixels + static_cast<size_t>((width + 1) / 2) * 2 * ((height + 1) / 2);
+        return 0;
+    }
+
+    void yuyvToI420(const uint8_t *src, int srcStride, int width, int height,
+                    uint8_t *dstY, int strideY, uint8_t *dstU, int strideU, uint8_t *dstV, int strideV)
+    {
+        for (int row = 0; row < height; row += 2)
+        {
+            const bool pair = row + 1 < height;
+            yuyvRowPair(src + static_cast<size_t>(row) * srcStride,
+                        pair ? src + static_cast<size_t>(row + 1) * srcStride : nullptr, width,
+                        dstY + static_cast<size_t>(row) * strideY,
+                        pair ? dstY + static_cast<size_t>(row + 1) * strideY : nullptr,
+                        dstU + static_cast<size_t>(row / 2) * strideU,
+                        dstV + static_cast<size_t>(row / 2) * strideV);
+        }
+    }
+
+    void nv12ToI420(const uint8_t *srcY, int srcStrideY, const uint8_t *srcUV, int srcStrideUV, int width, int height,
+                    uint8_t *dstY, int strideY, uint8_t *dstU, int strideU, uint8_t *dstV, int strideV)
+    {
+        for (int row = 0; row < height; ++row)
+        {
+            memcpy(dstY + static_cast<size_t>(row) * strideY, srcY + static_cast<size_t>(row) * srcStrideY, width);
+        }
+        const int chromaWidth = (width + 1) / 2;
+        const int chromaHeight = (height + 1) / 2;
+        for (int row = 0; row < chromaHeight; ++row)
+        {
+            splitUV(srcUV + static_cast<size_t>(row) * srcStrideUV, chromaWidth,
+                    dstU + static_cast<size_t>(row) * strideU, dstV + static_cast<size_t>(row) * strideV);
+        }
+    }
+
+    const char *pixelConvertBackend()
+    {
+#if defined(__AVX2__)
+        return "avx2";
+#elif defined(__SSE2__)
+        return "sse2";
+#elif defined(__ARM_NEON)
+        return "neon";
+#else
+        return "scalar";
+#endif
+    }
+} // namespace VideoStreamer
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <libobsensor/ObSensor.hpp>
+
+namespace VideoStreamer
+{
+    /**
+     * 是否为编码器可以直接转换的未压缩格式（YUYV、NV12）
+     */
+    bool isRawFormat(ob_format format);
+
+    /**
+     * 未压缩帧的数据大小（按紧密排列计算），不支持的格式返回0
+     */
+    size_t rawFrameSize(ob_format format, int width, int height);
+
+    /**
+     * YUYV（4:2:2打包）转I420：亮度逐像素拆出，色度取上下两行的平均（四舍五入）
+     * 行宽须为偶数；奇数高度时最后一行的色度只取该行
+     */
+    void yuyvToI420(const uint8_t *src, int srcStride, int width, int height,
+                    uint8_t *dstY, int strideY, uint8_t *dstU, int strideU, uint8_t *dstV, int strideV);
+
+    /**
+     * NV12转I420：亮度平面逐行复制，交织的UV平面拆分为U、V两个平面
+     */
+    void nv12ToI420(const uint8_t *srcY, int srcStrideY, const uint8_t *srcUV, int srcStrideUV, int width, int height,
+                    uint8_t *dstY, int strideY, uint8_t *dstU, int strideU, uint8_t *dstV, int strideV);
+
+    /**
+     * 编译时选择的向量指令集（"avx2"、"sse2"、"neon"或"scalar"），用于日志和基准测试
+     */
+    const char *pixelConvertBackend();
+} // namespace VideoStreamer
@@ -0,0 +1,116 @@
+#include "rate_controller.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace VideoStreamer
+{
+    namespace
+    {
+        const double kDecreaseFactor = 0.7;   // 拥塞时码率/帧率的降低比例
+        const double kIncreaseFactor = 1.1;   // 恢复时码率的提高比例
+        const double kHeadroom = 0.8;         // 码率最多使用上传能力的比例
+        const double kThroughputAlpha = 0.3;  // 吞吐滑动平均的权重
+        const int kCalmIntervalsToRaise = 3;  // 连续多少个平稳周期后才提高
+    } // namespace
+
+    RateController::RateController(const AppConfig &cfg)
+        : config(cfg),
+          // 只有自适应模式才限制在[minBitRate, maxBitRate]内，关闭时始终使用配置的码率
+          targetBitRate(cfg.adaptiveRate ? std::min(std::max(cfg.bitRate, cfg.minBitRate), cfg.maxBitRate) : cfg.bitRate),
+          targetFrameRate(cfg.targetFPS),
+          lastUpdate(std::chrono::steady_clock::now())
+    {
+    }
+
+    void RateController::recordUpload(size_t bytes, std::chrono::steady_clock::duration elapsed)
+    {
+        double seconds = std::chrono::duration<double>(elapsed).count();
+        if (bytes == 0 || seconds <= 0.0)
+            return;
+
+        double sample = bytes * 8.0 / seconds;
+        std::lock_guard<std::mutex> lock(mutex);
+        throughputBps = throughputBps == 0.0 ? sample
+                                             : kThroughputAlpha * sample + (1.0 - kThroughputAlpha) * throughputBps;
+    }
+
+    bool RateController::update(size_t backlog)
+    {
+        if (!config.adaptiveRate)
+            return false;
+
+        std::unique_lock<std::mutex> updateLock(updateMutex, std::try_to_lock);
+        if (!updateLock.owns_lock())
+            return false; // 其他编码线程正在更新
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastUpdate < std::chrono::milliseconds(config.rateControlIntervalMs))
+            return false;
+        lastUpdate = now;
+
+        // 所有上传线程并行时的总上传能力，按码流数平分
+        double capacityBps;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            capacityBps = throughputBps * std::max(config.uploadThreads, 1) / streams;
+        }
+
+        const int64_t bitRate = targetBitRate;
+        const double frameRate = targetFrameRate;
+        int64_t newBitRate = bitRate;
+        double newFrameRate = frameRate;
+
+        // 只在已有积压时才参考上传能力（小分段的单次吞吐受请求延迟影响，偏低）
+        const bool overCapacity = backlog > config.backlogLowWatermark && capacityBps > 0.0 &&
+                                  bitRate > capacityBps * kHeadroom;
+        if (backlog > config.backlogHighWatermark || overCapacity)
+        {
+            // 拥塞：先降码率，码率到下限后再降帧率
+            calmIntervals = 0;
+            if (bitRate > config.minBitRate)
+            {
+                double limit = bitRate * kDecreaseFactor;
+                if (capacityBps > 0.0)
+                    limit = std::min(limit, capacityBps * kHeadroom);
+                newBitRate = std::max<int64_t>(static_cast<int64_t>(limit), config.minBitRate);
+            }
+            else if (backlog > config.backlogHighWatermark)
+            {
+                newFrameRate = std::max<double>(frameRate * kDecreaseFactor, config.minFPS);
+            }
+        }
+        else if (backlog <= config.backlogLowWatermark && ++calmIntervals >= kCalmIntervalsToRaise)
+        {
+            // 积压已排空：先恢复帧率，再逐步提高码率
+            calmIntervals = 0;
+            if (frameRate < config.targetFPS)
+            {
+                newFrameRate = std::min<double>(frameRate / kDecreaseFactor, config.targetFPS);
+            }
+            else if (bitRate < config.maxBitRate)
+            {
+                newBitRate = std::min<int64_t>(static_cast<int64_t>(bitRate * kIncreaseFactor), config.maxBitRate);
+            }
+        }
+
+        if (newBitRate == bitRate && newFrameRate == frameRate)
+            return false;
+
+        targetBitRate = newBitRate;
+        targetFrameRate = newFrameRate;
+        std::cout << "[RateController] 积压 " << backlog << "，每路上传能力 " << static_cast<int64_t>(capacityBps)
+                  << " bps，码率 " << bitRate << " -> " << newBitRate << " bps，帧率 " << frameRate << " -> "
+                  << newFrameRate << " fps" << std::endl;
+        return true;
+    }
+
+    bool RateController::admitFrame(double &credit) const
+    {
+        // 每帧累加 目标帧率/采集帧率，累计满1时保留一帧，使保留的帧均匀分布
+        credit += targetFrameRate / std::max(config.targetFPS, 1);
+        if (credit < 1.0)
+            return false;
+        credit = std::min(credit - 1.0, 1.0);
+        return true;
+    }
+} // namespace VideoStreamer
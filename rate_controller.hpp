@@ -0,0 +1,69 @@
+#pragma once
+#include "config.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace VideoStreamer
+{
+    /**
+     * RateController类，根据上传积压和实测上传吞吐调整编码码率和采集帧率
+     * 积压超过高水位或码率超过上传能力时按比例降低码率，码率到下限后再降低帧率；
+     * 积压连续低于低水位后先恢复帧率，再逐步提高码率
+     */
+    class RateController
+    {
+    public:
+        explicit RateController(const AppConfig &cfg);
+
+        /**
+         * 记录一次成功上传的字节数和耗时（上传线程调用）
+         */
+        void recordUpload(size_t bytes, std::chrono::steady_clock::duration elapsed);
+
+        /**
+         * 设置共享上传能力的码流数（多摄像头时按总码率与上传能力比较）
+         */
+        void setStreams(size_t count) { streams = std::max<size_t>(count, 1); }
+
+        /**
+         * 根据当前积压（待上传分段数）更新目标，距上次更新不足一个周期时直接返回
+         * 可被多个编码线程同时调用，同一时刻只有一个线程执行更新；目标发生变化时返回true
+         */
+        bool update(size_t backlog);
+
+        /**
+         * 当前目标码率（bps）
+         */
+        int64_t bitRate() const { return targetBitRate; }
+
+        /**
+         * 当前目标采集帧率
+         */
+        double frameRate() const { return targetFrameRate; }
+
+        /**
+         * 按目标帧率抽帧，返回true表示保留该帧
+         * credit为调用方（每个采集线程）各自的抽帧累加器
+         */
+        bool admitFrame(double &credit) const;
+
+    private:
+        // 配置参数
+        AppConfig config;
+
+        std::atomic<int64_t> targetBitRate; // 目标码率
+        std::atomic<double> targetFrameRate; // 目标帧率
+
+        std::mutex mutex;                // 保护吞吐统计
+        double throughputBps = 0.0;      // 单个上传线程的实测吞吐（指数滑动平均，bit/s）
+        size_t streams = 1;              // 共享上传能力的码流数
+
+        std::mutex updateMutex;          // 保证同一时刻只有一个线程执行update
+        std::chrono::steady_clock::time_point lastUpdate; // 上次更新时刻
+        int calmIntervals = 0;           // 积压连续低于低水位的周期数
+    };
+} // namespace VideoStreamer
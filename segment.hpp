@@ -0,0 +1,100 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace VideoStreamer
+{
+    /**
+     * 关键帧索引项：分段中可以开始解码的位置
+     */
+    struct KeyframeEntry
+    {
+        uint64_t offset = 0;                        // 在分段数据中的字节偏移
+        std::chrono::system_clock::time_point time; // 该关键帧的采集时刻
+    };
+
+    /**
+     * Segment结构体，描述一个编码完成、等待上传的视频分段
+     */
+    struct Segment
+    {
+        std::string path;       // 本地文件路径（内存分段只有在需要落盘时才使用该文件名）
+        std::string extension;  // 对象名后缀（例如".ts"、".mp4"、".h264"）
+        std::string objectPrefix; // OSS对象前缀（多摄像头时按摄像头区分），为空时使用配置的uploadPrefix
+        uint64_t sequence = 0;  // 同一摄像头内按采集顺序递增的分段序号
+        std::chrono::system_clock::time_point startTime; // 第一帧的采集时刻
+        std::chrono::system_clock::time_point endTime;   // 最后一帧的采集时刻
+        size_t frameCount = 0;  // 帧数
+        size_t bytes = 0;       // 文件大小
+
+        // 画面活动信息（启用运动检测时填写，analyzedFrames为0表示没有活动信息）
+        size_t analyzedFrames = 0; // 经过运动分析的帧数
+        size_t motionFrames = 0;   // 检测到运动的帧数
+        float motionPeak = 0.0f;   // 帧间变化像素比例的最大值
+
+        // 关键帧索引（按偏移递增），播放工具按时间找到关键帧后只需范围下载对应部分
+        uint64_t headerBytes = 0;               // 文件头字节数（MP4/MKV从中间播放时需要先获取文件头）
+        std::vector<KeyframeEntry> keyframes;   // 可随机访问的关键帧位置
+
+        // 编码器输出的内存数据，为空表示数据在path文件中
+        std::shared_ptr<const std::vector<uint8_t>> data;
+
+        bool inMemory() const { return data != nullptr; }
+
+        /**
+         * 累计一帧的运动分析结果（motion小于0表示该帧未分析）
+         */
+        void recordMotion(float motion, double threshold)
+        {
+            if (motion < 0.0f)
+                return;
+            ++analyzedFrames;
+            if (motion >= threshold)
+                ++motionFrames;
+            motionPeak = std::max(motionPeak, motion);
+        }
+
+        /**
+         * 关键帧索引的紧凑文本形式："偏移@相对startTime的毫秒,..."，用于对象元数据和spool日志
+         */
+        std::string indexString() const
+        {
+            std::ostringstream out;
+            for (size_t i = 0; i < keyframes.size(); ++i)
+            {
+                auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(keyframes[i].time - startTime).count();
+                out << (i ? "," : "") << keyframes[i].offset << "@" << ms;
+            }
+            return out.str();
+        }
+
+        /**
+         * 解析indexString的输出（startTime需已设置），格式错误时返回false
+         */
+        bool parseIndex(const std::string &text)
+        {
+            std::vector<KeyframeEntry> parsed;
+            std::istringstream in(text);
+            std::string item;
+            while (std::getline(in, item, ','))
+            {
+                KeyframeEntry entry;
+                long long ms = 0;
+                char at = 0;
+                std::istringstream fields(item);
+                if (!(fields >> entry.offset >> at >> ms) || at != '@')
+                    return false;
+                entry.time = startTime + std::chrono::milliseconds(ms);
+                parsed.push_back(entry);
+            }
+            keyframes.swap(parsed);
+            return true;
+        }
+    };
+} // namespace VideoStreamer
@@ -0,0 +1,144 @@
+#include "segment_coalescer.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace VideoStreamer
+{
+    SegmentCoalescer::SegmentCoalescer(const AppConfig &cfg) : config(cfg)
+    {
+    }
+
+    bool SegmentCoalescer::canConcatenate(const Segment &segment)
+    {
+        // H.264裸流每个分段以IDR和SPS/PPS开始，MPEG-TS每个分段自带PAT/PMT，首尾相接仍可连续播放
+        return segment.extension == ".h264" || segment.extension == ".ts";
+    }
+
+    std::shared_ptr<const std::vector<uint8_t>> SegmentCoalescer::loadData(const Segment &segment)
+    {
+        if (segment.inMemory())
+            return segment.data;
+
+        std::ifstream in(segment.path, std::ios::binary);
+        if (!in.is_open())
+            return nullptr;
+        auto data = std::make_shared<std::vector<uint8_t>>(
+            (std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (in.bad())
+            return nullptr;
+        in.close();
+        std::remove(segment.path.c_str()); // 数据已在合并缓冲中，上传失败时整体写入spool
+        return data;
+    }
+
+    void SegmentCoalescer::add(Segment segment, std::deque<Segment> &ready)
+    {
+        if (!canConcatenate(segment))
+        {
+            ready.push_back(std::move(segment));
+            return;
+        }
+
+        auto data = loadData(segment);
+        if (!data)
+        {
+            std::cerr << "[SegmentCoalescer] 分段读取失败，单独上传: " << segment.path << std::endl;
+            ready.push_back(std::move(segment));
+            return;
+        }
+
+        // 封装格式变化时先输出之前的合并缓冲，同一个对象内只有一种格式
+        auto it = pending.find(segment.objectPrefix);
+        if (it != pending.end() && it->second.merged.extension != segment.extension)
+        {
+            emit(it, ready);
+            it = pending.end();
+        }
+
+        if (it == pending.end())
+        {
+            Pending fresh;
+            fresh.merged = segment;
+            fresh.merged.data.reset();
+            fresh.merged.bytes = 0;
+            fresh.merged.frameCount = 0;
+            fresh.merged.analyzedFrames = 0;
+            fresh.merged.motionFrames = 0;
+            fresh.merged.motionPeak = 0.0f;
+            fresh.merged.keyframes.clear();
+            fresh.data = std::make_shared<std::vector<uint8_t>>();
+            fresh.data->reserve(config.coalesceTargetBytes);
+            fresh.opened = std::chrono::steady_clock::now();
+            it = pending.emplace(segment.objectPrefix, std::move(fresh)).first;
+        }
+
+        // 追加数据，关键帧偏移按拼接位置平移
+        Pending &p = it->second;
+        const uint64_t base = p.data->size();
+        p.data->insert(p.data->end(), data->begin(), data->end());
+        for (auto entry : segment.keyframes)
+        {
+            entry.offset += base;
+            p.merged.keyframes.push_back(entry);
+        }
+        Segment &merged = p.merged;
+        merged.startTime = std::min(merged.startTime, segment.startTime);
+        merged.endTime = std::max(merged.endTime, segment.endTime);
+        merged.frameCount += segment.frameCount;
+        merged.analyzedFrames += segment.analyzedFrames;
+        merged.motionFrames += segment.motionFrames;
+        merged.motionPeak = std::max(merged.motionPeak, segment.motionPeak);
+        merged.bytes = p.data->size();
+        ++p.segments;
+
+        if (p.data->size() >= config.coalesceTargetBytes ||
+            merged.endTime - merged.startTime >= std::chrono::milliseconds(config.coalesceTargetMs))
+        {
+            emit(it, ready);
+        }
+        updateCounts();
+    }
+
+    void SegmentCoalescer::takeExpired(std::deque<Segment> &ready)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        for (auto it = pending.begin(); it != pending.end();)
+        {
+            auto current = it++;
+            if (now - current->second.opened >= std::chrono::milliseconds(config.coalesceTargetMs))
+                emit(current, ready);
+        }
+        updateCounts();
+    }
+
+    void SegmentCoalescer::flushAll(std::deque<Segment> &ready)
+    {
+        while (!pending.empty())
+            emit(pending.begin(), ready);
+        updateCounts();
+    }
+
+    void SegmentCoalescer::emit(std::map<std::string, Pending>::iterator it, std::deque<Segment> &ready)
+    {
+        Pending &p = it->second;
+        std::cout << "[SegmentCoalescer] 合并 " << p.segments << " 个分段，共 " << p.data->size() << " 字节" << std::endl;
+        p.merged.data = std::move(p.data);
+        ready.push_back(std::move(p.merged));
+        pending.erase(it);
+    }
+
+    void SegmentCoalescer::updateCounts()
+    {
+        size_t segments = 0, bytes = 0;
+        for (const auto &entry : pending)
+        {
+            segments += entry.second.segments;
+            bytes += entry.second.data->size();
+        }
+        segmentCount = segments;
+        byteCount = bytes;
+    }
+} // namespace VideoStreamer
@@ -0,0 +1,87 @@
+#pragma once
+#include "config.hpp"
+#include "segment.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace VideoStreamer
+{
+    /**
+     * SegmentCoalescer类，上传端的分段合并
+     * 每个摄像头（按对象前缀区分）有一个滚动的合并缓冲，连续的分段按顺序拼接，
+     * 达到coalesceTargetBytes或coalesceTargetMs后作为一个对象上传；关键帧索引和活动信息随之合并
+     * 只有可以直接拼接的格式（H.264裸流、MPEG-TS）参与合并，MP4/MKV/AVI分段原样输出
+     * 只由上传线程访问（统计值可在任意线程读取）
+     */
+    class SegmentCoalescer
+    {
+    public:
+        explicit SegmentCoalescer(const AppConfig &cfg);
+
+        /**
+         * 加入一个分段：不能合并的分段直接追加到ready；合并缓冲达到目标后，合并好的分段追加到ready
+         */
+        void add(Segment segment, std::deque<Segment> &ready);
+
+        /**
+         * 输出等待时间超过coalesceTargetMs的合并缓冲（摄像头停止出帧时也能及时上传）
+         */
+        void takeExpired(std::deque<Segment> &ready);
+
+        /**
+         * 输出所有合并缓冲（停止时调用）
+         */
+        void flushAll(std::deque<Segment> &ready);
+
+        /**
+         * 合并缓冲中尚未上传的分段数和字节数
+         */
+        size_t pendingSegments() const { return segmentCount; }
+        size_t pendingBytes() const { return byteCount; }
+
+    private:
+        // 一个摄像头的合并缓冲
+        struct Pending
+        {
+            Segment merged;                                // 合并后的分段信息（数据在data中）
+            std::shared_ptr<std::vector<uint8_t>> data;    // 拼接的数据
+            size_t segments = 0;                           // 已合并的分段数
+            std::chrono::steady_clock::time_point opened;  // 第一个分段加入的时刻
+        };
+
+        /**
+         * 是否可以直接拼接
+         */
+        static bool canConcatenate(const Segment &segment);
+
+        /**
+         * 读入分段数据（文件分段读入后删除本地文件），失败时返回nullptr
+         */
+        std::shared_ptr<const std::vector<uint8_t>> loadData(const Segment &segment);
+
+        /**
+         * 输出一个合并缓冲并从pending中移除
+         */
+        void emit(std::map<std::string, Pending>::iterator it, std::deque<Segment> &ready);
+
+        /**
+         * 更新统计值
+         */
+        void updateCounts();
+
+        // 配置参数
+        AppConfig config;
+
+        // 各摄像头的合并缓冲（键为对象前缀）
+        std::map<std::string, Pending> pending;
+
+        std::atomic<size_t> segmentCount{0};
+        std::atomic<size_t> byteCount{0};
+    };
+} // namespace VideoStreamer
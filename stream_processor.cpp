@@ -1,23 +1,198 @@
 #include "stream_processor.hpp"
 #include "oss_uploader.hpp"
+#include "pixel_convert.hpp"
+#include <algorithm>
 #include <chrono>
 #include <cstdio>
+#include <deque>
 #include <thread>
-#include <fstream>
+#include <sys/stat.h>
 
 namespace VideoStreamer
 {
-    StreamProcessor::StreamProcessor(const AppConfig &cfg)
+    namespace
+    {
+        // 多摄像头时每个摄像头的配置：按序列号选择设备，使用独立的对象前缀和临时目录
+        AppConfig cameraConfig(const AppConfig &cfg, const CameraConfig &camera)
+        {
+            AppConfig camCfg = cfg;
+            camCfg.cameraSerial = camera.serialNumber;
+            camCfg.uploadPrefix = camera.uploadPrefix.empty() ? cfg.uploadPrefix + camera.serialNumber + "/"
+                                                              : camera.uploadPrefix;
+            camCfg.liveOutputUrl = camera.liveOutputUrl; // 多个摄像头不能共用同一个实时输出地址
+            std::string baseDir = cfg.tempDir;
+            if (!baseDir.empty() && baseDir.back() != '/')
+                baseDir += '/';
+            mkdir(baseDir.c_str(), 0755); // 子目录由FrameStore创建，这里先确保上级目录存在
+            camCfg.tempDir = baseDir + camera.serialNumber + "/";
+            return camCfg;
+        }
+
+        // 事件录制触发时整个历史窗口会一次性涌入帧缓冲区，缓冲区在原有上限之外再容纳一个历史窗口
+        AppConfig frameStoreConfig(const AppConfig &cfg)
+        {
+            AppConfig storeCfg = cfg;
+            if (cfg.recordingMode == RecordingMode::Event)
+            {
+                int64_t preRollFrames = static_cast<int64_t>(cfg.preRollMs) * cfg.targetFPS / 1000;
+                storeCfg.maxQueueSize = cfg.maxQueueSize + static_cast<int>(preRollFrames);
+                storeCfg.maxQueueBytes = cfg.maxQueueBytes + cfg.preRollMaxBytes;
+            }
+            return storeCfg;
+        }
+    } // namespace
+
+    StreamProcessor::CameraStream::CameraStream(const AppConfig &cfg)
         : config(cfg),
           camera(cfg),
-          encoder(cfg),
-          frameQueue(std::make_shared<ThreadSafeQueue<std::string>>()) {}
+          captureQueue(cfg.captureQueueSize),
+          frameStore(frameStoreConfig(cfg)),
+          appliedBitRate(cfg.bitRate)
+    {
+        if (config.motionDetection)
+        {
+            motionDetector.reset(new MotionDetector(config));
+        }
+        if (config.recordingMode == RecordingMode::Event)
+        {
+            eventRecorder.reset(new EventRecorder(config));
+        }
+        for (const auto &rendition : resolveRenditions(config))
+        {
+            RenditionStream output;
+            output.rendition = rendition;
+            output.uploadPrefix = config.uploadPrefix + rendition.uploadPrefix;
+            renditions.push_back(std::move(output));
+        }
+    }
+
+    StreamProcessor::StreamProcessor(const AppConfig &cfg)
+        : config(cfg),
+          uploadQueue(cfg.uploadQueueCapacity, cfg.uploadQueuePolicy),
+          uploader(cfg),
+          spool(cfg),
+          rateController(cfg),
+          eventServer(cfg, [this](const std::string &camera)
+                      { return triggerEvent(camera); }),
+          metricsExporter(cfg, metrics)
+    {
+        if (config.cameras.empty())
+        {
+            cameras.emplace_back(new CameraStream(config)); // 单摄像头
+        }
+        else
+        {
+            for (const auto &camera : config.cameras)
+            {
+                cameras.emplace_back(new CameraStream(cameraConfig(config, camera)));
+                std::cout << "[StreamProcessor] 摄像头 " << camera.serialNumber << " -> "
+                          << cameras.back()->config.uploadPrefix << std::endl;
+            }
+        }
+        rateController.setStreams(cameras.size()); // 所有摄像头共享上传能力
+        if (config.coalesceSegments)
+        {
+            coalescer.reset(new SegmentCoalescer(config));
+        }
+
+        if (config.encoderBackend != EncoderBackend::Passthrough &&
+            config.segmentMode == SegmentMode::Continuous && config.encoderBackend != EncoderBackend::Libav)
+        {
+            std::cerr << "[StreamProcessor] 连续编码需要Libav后端，回退到批次模式" << std::endl;
+        }
+        if (!config.liveOutputUrl.empty() && config.encoderBackend != EncoderBackend::Passthrough &&
+            (config.segmentMode != SegmentMode::Continuous || config.encoderBackend != EncoderBackend::Libav))
+        {
+            std::cerr << "[StreamProcessor] 实时输出需要连续编码或直通模式，批次模式下不启用" << std::endl;
+        }
+        if (isRawFormat(config.colorFormat) && config.encoderBackend == EncoderBackend::Passthrough)
+        {
+            throw std::runtime_error("[StreamProcessor] 直通模式只支持MJPEG格式，未压缩格式需要编码");
+        }
+        if (!config.renditions.empty() && config.encoderBackend == EncoderBackend::Passthrough)
+        {
+            throw std::runtime_error("[StreamProcessor] 直通模式不编码，不支持编码阶梯");
+        }
+        const auto &ladder = cameras.front()->renditions;
+        for (size_t i = 0; i < ladder.size(); ++i)
+        {
+            for (size_t j = 0; j < i; ++j)
+            {
+                // 同一前缀下两个档位的对象和清单会混在一起
+                if (ladder[i].rendition.uploadPrefix == ladder[j].rendition.uploadPrefix)
+                {
+                    throw std::runtime_error("[StreamProcessor] 编码阶梯的档位 " + ladder[j].rendition.name + " 和 " +
+                                             ladder[i].rendition.name + " 使用相同的对象前缀");
+                }
+            }
+        }
+        for (auto &cam : cameras)
+        {
+            // 直通模式没有编码器，JPEG数据直接封装为连续分段
+            if (config.encoderBackend == EncoderBackend::Passthrough ||
+                (config.segmentMode == SegmentMode::Continuous && config.encoderBackend == EncoderBackend::Libav))
+            {
+                if (config.encoderBackend == EncoderBackend::Libav)
+                    cam->pictures.reset(new PictureLadder());
+                for (size_t i = 0; i < cam->renditions.size(); ++i)
+                {
+                    RenditionStream *output = &cam->renditions[i];
+                    AppConfig sessionCfg = cam->config;
+                    if (i > 0)
+                        sessionCfg.liveOutputUrl.clear(); // 实时输出只发送第一个档位
+                    output->session.reset(new EncodingSession(sessionCfg, [this, output](const Segment &segment)
+                                                              {
+                                                                  // 会话按顺序输出分段，直接分配该档位的序号
+                                                                  Segment ordered = segment;
+                                                                  ordered.sequence = output->nextSequence++;
+                                                                  ordered.objectPrefix = output->uploadPrefix;
+                                                                  enqueueSegment(std::move(ordered)); },
+                                                              output->rendition));
+                }
+            }
+        }
+
+        registerMetrics();
+    }
+
+    StreamProcessor::~StreamProcessor()
+    {
+        if (running)
+        {
+            stop();
+        }
+    }
 
     void StreamProcessor::start()
     {
-        running = true;        // 设置为运行状态
-        setupUploadWorkers();  // 设置上传工作线程
-        startProcessingLoop(); // 启动视频处理循环
+        running = true;          // 设置为运行状态
+        metricsExporter.start(); // 启动指标导出
+        uploadThread = std::thread(&StreamProcessor::uploadLoop, this); // 启动上传阶段
+
+        // 启动编码线程池：批次之间相互独立，可全部并行；
+        // 连续编码会话同一时刻只能由一个线程使用，线程数超过摄像头数没有意义
+        size_t workers = static_cast<size_t>(std::max(config.encodeThreads, 1));
+        if (cameras.front()->continuous())
+            workers = std::min(workers, cameras.size());
+        encodeWorkers = static_cast<int>(workers);
+        for (size_t i = 0; i < workers; ++i)
+        {
+            encodeThreads.emplace_back(&StreamProcessor::encodeLoop, this);
+        }
+
+        // 启动各摄像头的帧存储和采集线程
+        for (auto &cam : cameras)
+        {
+            cam->storeThread = std::thread(&StreamProcessor::storeLoop, this, std::ref(*cam));
+
+            // 摄像头支持时由SDK回调直接推帧，否则启动轮询的采集线程
+            CameraStream *stream = cam.get();
+            cam->callbackCapture = cam->camera.start([this, stream](FramePtr frame)
+                                                     { deliverFrame(*stream, std::move(frame)); });
+            if (!cam->callbackCapture)
+                cam->captureThread = std::thread(&StreamProcessor::captureLoop, this, std::ref(*cam));
+        }
+        eventServer.start(); // 事件录制模式下接收触发命令
     }
 
     void StreamProcessor::stop()
@@ -26,154 +201,766 @@ namespace VideoStreamer
         cleanup();       // 清理资源
     }
 
-    void StreamProcessor::setupUploadWorkers()
+    StageStats StreamProcessor::stats() const
+    {
+        StageStats s;
+        s.captured = captured;
+        s.captureDropped = captureDropped;
+        for (const auto &cam : cameras)
+            s.captureLost += cam->camera.droppedFrames();
+        s.rateDropped = rateDropped;
+        s.staticSkipped = staticSkipped;
+        for (const auto &cam : cameras)
+        {
+            if (cam->eventRecorder)
+                s.events += cam->eventRecorder->events();
+        }
+        s.stored = stored;
+        s.storeDropped = storeDropped;
+        s.encodedSegments = encodedSegments;
+        s.encodeFailed = encodeFailed;
+        s.uploadDropped = uploadDropped;
+        s.uploaded = uploaded;
+        s.uploadFailed = uploadFailed;
+        s.spooled = spooled;
+        s.spoolBacklog = spool.size();
+        s.bitRate = rateController.bitRate();
+        s.frameRate = rateController.frameRate();
+
+        // 编码能力 = 单线程每秒可编码的帧数 × 编码线程数
+        s.encodeWorkers = encodeWorkers;
+        double busySeconds = encodeBusyUs / 1e6;
+        if (busySeconds > 0.0)
+            s.encodeCapacityFps = encodedFrames / busySeconds * std::max(s.encodeWorkers, 1);
+        s.requiredFps = static_cast<double>(config.targetFPS) * cameras.size();
+        s.encodeKeepingUp = busySeconds <= 0.0 || s.encodeCapacityFps >= s.requiredFps;
+        return s;
+    }
+
+    void StreamProcessor::uploadLoop()
     {
-        for (int i = 0; i < config.uploadThreads; ++i) // 根据配置启动多个上传线程
+        const size_t maxInFlight = static_cast<size_t>(std::max(config.uploadThreads, 1));
+        std::deque<Segment> coalesced; // 合并完成、等待上传的对象
+        while (true)
         {
-            workers.emplace_back(
-                [this]()
+            // 等待空闲的上传名额
+            {
+                std::unique_lock<std::mutex> lock(uploadMutex);
+                uploadDone.wait(lock, [&]()
+                                { return uploadsInFlight < maxInFlight; });
+            }
+
+            // 限速时积压最多占用maxInFlight-1个名额，留一个给新分段，避免新分段排在慢速的积压之后
+            bool allowBacklog = true;
+            if (uploader.bandwidth().enabled() && maxInFlight > 1)
+            {
+                std::lock_guard<std::mutex> lock(uploadMutex);
+                allowBacklog = backlogInFlight + 1 < maxInFlight;
+            }
+
+            Segment segment;
+            bool fromSpool = false;
+            if (!coalesced.empty())
+            {
+                segment = std::move(coalesced.front());
+                coalesced.pop_front();
+            }
+            else
+            {
+                bool open = nextUpload(segment, fromSpool, allowBacklog);
+                if (coalescer && !fromSpool)
                 {
-                    OSSUploader uploader(config); // 创建OSS上传对象
-                    while (running)
-                    { // 保持上传线程运行状态
-                        processUpload(uploader);
-                    }
-                });
+                    // 新分段先进入合并缓冲；队列关闭后输出所有剩余的合并缓冲
+                    if (!segment.path.empty())
+                        coalescer->add(std::move(segment), coalesced);
+                    if (open)
+                        coalescer->takeExpired(coalesced);
+                    else
+                        coalescer->flushAll(coalesced);
+                    if (open || !coalesced.empty())
+                        continue;
+                }
+                if (!open)
+                    break; // 队列关闭且已清空
+
+                if (segment.path.empty())
+                    continue; // 等待超时，没有可上传的分段
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(uploadMutex);
+                ++uploadsInFlight;
+                if (fromSpool)
+                    ++backlogInFlight;
+            }
+            std::cout << "[StreamProcessor] Uploading file: " << segment.path << std::endl; // 打印出待上传文件的路径
+            auto begin = std::chrono::steady_clock::now();
+            uploader.uploadSegmentAsync(segment, [this, fromSpool, begin](const Segment &done, bool ok)
+                                        {
+                                            onUploadComplete(done, fromSpool, ok, std::chrono::steady_clock::now() - begin);
+                                            std::lock_guard<std::mutex> lock(uploadMutex);
+                                            --uploadsInFlight;
+                                            if (fromSpool)
+                                                --backlogInFlight;
+                                            uploadDone.notify_all();
+                                        },
+                                        fromSpool ? UploadLane::Backlog : UploadLane::Live);
+        }
+
+        // 等待在途的上传全部完成
+        std::unique_lock<std::mutex> lock(uploadMutex);
+        uploadDone.wait(lock, [this]()
+                        { return uploadsInFlight == 0; });
+    }
+
+    bool StreamProcessor::nextUpload(Segment &segment, bool &fromSpool, bool allowBacklog)
+    {
+        // 新分段优先；没有新分段时重试spool中已到时间的积压，都没有时阻塞等待
+        fromSpool = false;
+        if (uploadQueue.tryPop(segment))
+            return true;
+        if (allowBacklog && !uploadQueue.isClosed() && spool.takeDue(segment))
+        {
+            fromSpool = true;
+            return true;
         }
+        if (uploadQueue.pop(segment, std::chrono::milliseconds(500))) // 关闭队列时立即返回
+            return true;
+        segment = Segment();
+        return !uploadQueue.isClosed();
     }
 
-    void StreamProcessor::processUpload(OSSUploader &uploader)
+    void StreamProcessor::onUploadComplete(const Segment &segment, bool fromSpool, bool ok,
+                                           std::chrono::steady_clock::duration elapsed)
     {
-        auto file = uploadQueue.pop(); // 从上传队列中取出文件
-        if (!file.empty())
+        uploadSeconds->observe(std::chrono::duration<double>(elapsed).count());
+        if (ok)
         {
-            std::cout << "[StreamProcessor] Uploading file: " << file << std::endl; // 打印出待上传文件的路径
-            uploader.uploadFile(file);                                              // 执行上传操作
+            ++uploaded;
+            uploadedBytes += segment.bytes;
+            // 实测上传吞吐；限速时积压只分到剩余带宽，其耗时不代表上传能力
+            if (!fromSpool || !uploader.bandwidth().enabled())
+                rateController.recordUpload(segment.bytes, elapsed);
+            glassToCloudSeconds->observe(
+                std::chrono::duration<double>(std::chrono::system_clock::now() - segment.startTime).count());
+            if (fromSpool)
+                spool.complete(segment);
+            spool.recordSuccess(); // 失败期后的第一次成功说明网络已恢复，积压的分段立即重试
         }
         else
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            ++uploadFailed;
+            if (fromSpool)
+            {
+                // 积压分段的重试失败不算失败期：非网络原因持续失败的分段不应在每次成功后被提前重试
+                spool.retryLater(segment); // 按指数退避再次重试
+            }
+            else
+            {
+                spool.recordFailure();
+                spoolSegment(segment); // 写入spool，稍后重试
+            }
         }
     }
 
-    void StreamProcessor::startProcessingLoop()
+    bool StreamProcessor::triggerEvent(const std::string &cameraSerial)
+    {
+        auto now = std::chrono::system_clock::now();
+        bool found = false;
+        for (auto &cam : cameras)
+        {
+            if (!cam->eventRecorder || (!cameraSerial.empty() && cam->config.cameraSerial != cameraSerial))
+                continue;
+            cam->eventRecorder->trigger(now);
+            found = true;
+        }
+        if (found)
+        {
+            std::cout << "[StreamProcessor] 事件触发: " << (cameraSerial.empty() ? "所有摄像头" : cameraSerial) << std::endl;
+        }
+        return found;
+    }
+
+    void StreamProcessor::captureLoop(CameraStream &cam)
     {
-        int frameCounter = 0; // 帧计数器
         while (running)
         {
-            if (auto frame = camera.getFrame()) // 获取新的视频帧
+            auto frame = cam.camera.getFrame(); // 获取新的视频帧
+            if (frame)
+                deliverFrame(cam, std::move(frame));
+        }
+
+        cam.captureDone = true;
+        cam.captureReady.notify_one();
+    }
+
+    void StreamProcessor::deliverFrame(CameraStream &cam, FramePtr frame)
+    {
+        ++captured;
+        if (!rateController.admitFrame(cam.frameCredit))
+        {
+            ++rateDropped; // 上传跟不上时按目标帧率抽帧
+            return;
+        }
+        if (!cam.captureQueue.tryPush(std::move(frame)))
+        {
+            ++captureDropped; // 帧存储阶段跟不上，丢弃当前帧而不是阻塞采集
+            return;
+        }
+        cam.captureReady.notify_one();
+    }
+
+    void StreamProcessor::storeLoop(CameraStream &cam)
+    {
+        FramePtr frame;
+        std::vector<FramePtr> ready; // 本次要存入帧缓冲区的帧（事件触发时包含整个历史窗口）
+        while (true)
+        {
+            if (!cam.captureQueue.tryPop(frame))
+            {
+                if (cam.captureDone)
+                {
+                    if (!cam.captureQueue.tryPop(frame))
+                        break; // 采集已结束且队列已清空
+                }
+                else
+                {
+                    // 采集线程推送后不加锁通知，这里用短超时兜底，避免错过唤醒
+                    std::unique_lock<std::mutex> lock(cam.captureMutex);
+                    cam.captureReady.wait_for(lock, std::chrono::milliseconds(5));
+                    continue;
+                }
+            }
+
+            try
+            {
+                if (cam.motionDetector && !cam.motionDetector->admit(*frame))
+                {
+                    ++staticSkipped; // 画面静止，按保活间隔抽帧
+                    frame.reset();
+                    continue;
+                }
+
+                if (cam.eventRecorder)
+                {
+                    // 事件录制：空闲时帧只进入历史窗口，不编码也不上传
+                    if (cam.eventRecorder->admit(frame, ready))
+                    {
+                        cam.eventEnded = true; // 事件结束，让编码线程立即输出最后一个分段
+                        encodeReady.notify_one();
+                    }
+                }
+                else
+                {
+                    ready.push_back(frame);
+                }
+
+                if (!ready.empty())
+                {
+                    auto begin = std::chrono::steady_clock::now();
+                    for (const auto &f : ready)
+                        storeDropped += cam.frameStore.push(f); // 存入帧缓冲区（超出上限时丢弃最旧的帧）
+                    frameWriteSeconds->observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+                    stored += ready.size();
+                    encodeReady.notify_one();
+                }
+            }
+            catch (const std::exception &e)
             {
-                handleNewFrame(frame, frameCounter); // 处理视频帧
+                ++storeDropped;
+                std::cerr << "[StreamProcessor] 帧处理错误: " << e.what() << std::endl; // 捕获并输出异常
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(10)); // 控制帧获取的频率
+            ready.clear();
+            frame.reset();
         }
+
+        cam.frameStore.close(); // 通知编码阶段不会再有新帧
+        encodeReady.notify_all();
     }
 
-    void StreamProcessor::handleNewFrame(std::shared_ptr<ob::ColorFrame> frame, int &counter)
+    void StreamProcessor::encodeLoop()
     {
-        try
+        std::unique_ptr<VideoEncoder> encoder; // 本线程的批次编码器（首个批次时创建）
+        int64_t encoderBitRate = 0;
+        size_t next = 0; // 轮询起点，各摄像头轮流获得编码线程
+        while (true)
         {
-            auto tmpFile = saveTempFrame(frame); // 保存帧为临时文件
-            manageFrameQueue(tmpFile);           // 管理帧队列
-            checkBatchEncoding(++counter);       // 检查是否需要进行批量编码
+            bool worked = false;
+            size_t finished = 0;
+            for (size_t i = 0; i < cameras.size(); ++i)
+            {
+                auto &cam = *cameras[(next + i) % cameras.size()];
+                if (cam.claimed.exchange(true))
+                    continue; // 其他编码线程正在处理该摄像头
+                if (cam.finished)
+                {
+                    ++finished;
+                    cam.claimed = false;
+                }
+                else if (cam.continuous())
+                {
+                    worked |= encodeCamera(cam);
+                    cam.claimed = false;
+                }
+                else
+                {
+                    // 批次模式：只在取批次时独占摄像头，编码时释放，其他线程可以并行编码下一批
+                    std::vector<FramePtr> batch;
+                    uint64_t sequence = 0;
+                    bool taken = takeBatch(cam, batch, sequence);
+                    cam.claimed = false;
+                    if (!taken)
+                        continue;
+
+                    if (!encoder)
+                    {
+                        encoder.reset(new VideoEncoder(config));
+                        encoderBitRate = config.bitRate;
+                    }
+                    rateController.update(uploadQueue.size() + spool.size());
+                    if (rateController.bitRate() != encoderBitRate)
+                    {
+                        encoderBitRate = rateController.bitRate();
+                        encoder->setBitRate(encoderBitRate);
+                    }
+                    processBatchEncoding(cam, *encoder, std::move(batch), sequence);
+                    worked = true;
+                }
+            }
+            next++;
+
+            if (finished == cameras.size())
+                break; // 所有摄像头的帧都已编码
+            if (!worked)
+            {
+                // 帧存储线程推送后不加锁通知，这里用短超时兜底，避免错过唤醒
+                std::unique_lock<std::mutex> lock(encodeMutex);
+                encodeReady.wait_for(lock, std::chrono::milliseconds(20));
+            }
         }
-        catch (const std::exception &e)
+    }
+
+    bool StreamProcessor::encodeCamera(CameraStream &cam)
+    {
+        // 连续模式下有帧就送入编码器
+        const size_t groupSize = static_cast<size_t>(std::max(config.h264GroupSize, 1));
+        applyRateControl(cam);
+        if (cam.frameStore.waitForFrames(1, std::chrono::milliseconds(0)))
         {
-            std::cerr << "[StreamProcessor] 帧处理错误: " << e.what() << std::endl; // 捕获并输出异常
+            size_t dropped = 0;
+            auto batch = cam.frameStore.popBatch(groupSize, dropped);
+            storeDropped += dropped;
+            processContinuousEncoding(cam, std::move(batch));
+            return true;
         }
+        // 帧存储阶段已结束且没有剩余帧，或者一次事件录制刚结束：冲刷编码器，输出最后一个分段
+        bool drained = cam.frameStore.drained();
+        if (!drained && !cam.eventEnded.exchange(false))
+            return false;
+
+        for (auto &output : cam.renditions)
+        {
+            try
+            {
+                output.session->flush(); // 冲刷后编码器在下一帧时重建，会话可以继续使用
+            }
+            catch (const std::exception &e)
+            {
+                ++encodeFailed;
+                std::cerr << "[StreamProcessor] 编码失败: " << e.what() << std::endl;
+            }
+        }
+        if (drained)
+            cam.finished = true;
+        return true;
     }
 
-    std::string StreamProcessor::saveTempFrame(std::shared_ptr<ob::ColorFrame> frame)
+    bool StreamProcessor::takeBatch(CameraStream &cam, std::vector<FramePtr> &batch, uint64_t &sequence)
     {
-        // 确保目录以斜杠结尾
-        std::string dir = config.tempDir;
-        if (!dir.empty() && dir.back() != '/')
+        // 批次模式下凑够一批再编码；帧存储阶段结束后剩余不足一批的帧也编码
+        // 事件录制结束后，剩余不足一批的帧也立即编码
+        const size_t groupSize = static_cast<size_t>(std::max(config.h264GroupSize, 1));
+        const bool eventEnded = cam.eventEnded;
+        if (cam.frameStore.waitForFrames(eventEnded ? 1 : groupSize, std::chrono::milliseconds(0)))
         {
-            dir += '/';
+            size_t dropped = 0;
+            batch = cam.frameStore.popBatch(groupSize, dropped);
+            storeDropped += dropped;
+            if (batch.empty())
+                return false;
+            sequence = cam.nextSequence++;
+            return true;
         }
+        if (eventEnded)
+            cam.eventEnded = false;
+        if (cam.frameStore.drained())
+            cam.finished = true;
+        return false;
+    }
 
-        char filename[128];
-        char savePath[128];
-        snprintf(filename, sizeof(filename), "frame_%ld.jpg",
-                 std::chrono::high_resolution_clock::now()
-                     .time_since_epoch()
-                     .count());
-        snprintf(savePath, sizeof(savePath), "%s%s", config.tempDir.c_str(), filename);
+    void StreamProcessor::applyRateControl(CameraStream &cam)
+    {
+        rateController.update(uploadQueue.size() + spool.size());
+        int64_t bitRate = rateController.bitRate();
+        if (bitRate == cam.appliedBitRate)
+            return;
 
-        std::ofstream file(savePath, std::ios::binary);                               // 打开文件进行二进制写入
-        file.write(reinterpret_cast<const char *>(frame->data()), frame->dataSize()); // 写入帧数据
-        return filename;                                                              // 返回文件名
+        cam.appliedBitRate = bitRate;
+        for (auto &output : cam.renditions)
+            output.session->setBitRate(renditionBitRate(output.rendition, bitRate, config.bitRate));
     }
 
-    void StreamProcessor::manageFrameQueue(const std::string &filename)
+    void StreamProcessor::processBatchEncoding(CameraStream &cam, VideoEncoder &encoder, std::vector<FramePtr> batch,
+                                               uint64_t sequence)
     {
-        frameQueue->push(filename);                   // 将文件名加入队列
-        if (frameQueue->size() > config.maxQueueSize) // 如果队列超过最大长度
+        // 文件名带上序号，并行编码的批次不会重名；多个档位时再带上档位名称
+        long stamp = static_cast<long>(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+        std::vector<Segment> segments(cam.renditions.size());
+        std::vector<std::string> outputFiles;
+        for (size_t i = 0; i < segments.size(); ++i)
         {
-            std::remove(frameQueue->pop().c_str()); // 删除队列中的旧文件
+            const std::string &name = cam.renditions[i].rendition.name;
+            char outputFile[192];
+            snprintf(outputFile, sizeof(outputFile), "%sout_%ld_%llu%s%s.h264", // 生成输出文件名
+                     cam.config.tempDir.c_str(), stamp, static_cast<unsigned long long>(sequence),
+                     name.empty() ? "" : "_", name.c_str());
+            segments[i].path = outputFile;
+            outputFiles.push_back(outputFile);
         }
+
+        auto begin = std::chrono::steady_clock::now();
+        try
+        {
+            if (config.inMemorySegments && encoder.supportsMemoryOutput())
+            {
+                // 编码到内存，由上传线程直接上传；只有上传失败时才写入path
+                std::vector<std::vector<uint8_t>> buffers(segments.size());
+                encoder.encode(batch, buffers);
+                for (size_t i = 0; i < segments.size(); ++i)
+                {
+                    segments[i].bytes = buffers[i].size();
+                    segments[i].data = std::make_shared<std::vector<uint8_t>>(std::move(buffers[i]));
+                }
+            }
+            else
+            {
+                encoder.encode(batch, outputFiles); // 执行编码
+                for (auto &segment : segments)
+                {
+                    struct stat statBuf;
+                    if (stat(segment.path.c_str(), &statBuf) == 0)
+                        segment.bytes = static_cast<size_t>(statBuf.st_size);
+                }
+            }
+            cam.frameStore.retire(batch); // 按删除策略处理帧的磁盘副本
+            auto elapsed = std::chrono::steady_clock::now() - begin;
+            encodeBatchSeconds->observe(std::chrono::duration<double>(elapsed).count());
+            recordEncode(batch.size(), elapsed);
+        }
+        catch (const std::exception &e)
+        {
+            ++encodeFailed;
+            std::cerr << "[StreamProcessor] 编码失败: " << e.what() << std::endl;
+            releaseInOrder(cam, sequence, std::vector<Segment>()); // 跳过该序号，后面的分段不必等待
+            return;
+        }
+
+        for (size_t i = 0; i < segments.size(); ++i)
+        {
+            Segment &segment = segments[i];
+            segment.extension = ".h264";
+            segment.objectPrefix = cam.renditions[i].uploadPrefix;
+            segment.sequence = sequence;
+            segment.startTime = batch.front()->captureTime;
+            segment.endTime = batch.back()->captureTime;
+            segment.frameCount = batch.size();
+            segment.keyframes.push_back(KeyframeEntry{0, segment.startTime}); // 每个批次以IDR帧开始
+            for (const auto &frame : batch)
+                segment.recordMotion(frame->motion, config.motionThreshold);
+        }
+        releaseInOrder(cam, sequence, std::move(segments));
     }
 
-    void StreamProcessor::checkBatchEncoding(int counter)
+    void StreamProcessor::processContinuousEncoding(CameraStream &cam, std::vector<FramePtr> frames)
     {
-        if (counter % config.h264GroupSize == 0) // 每当帧数达到指定数量时进行批量编码
+        auto begin = std::chrono::steady_clock::now();
+        for (const auto &frame : frames)
         {
-            processBatchEncoding(); // 执行批量编码
+            // 各档位共享一次解码（直通模式没有编码器，直接封装）
+            bool loaded = false;
+            try
+            {
+                loaded = !cam.pictures || cam.pictures->load(*frame);
+            }
+            catch (const std::exception &e)
+            {
+                ++encodeFailed;
+                std::cerr << "[StreamProcessor] 编码失败: " << e.what() << std::endl;
+            }
+            if (!loaded)
+                continue;
+
+            for (auto &output : cam.renditions)
+            {
+                try
+                {
+                    if (cam.pictures)
+                        output.session->push(frame, *cam.pictures);
+                    else
+                        output.session->push(frame);
+                }
+                catch (const std::exception &e)
+                {
+                    ++encodeFailed;
+                    std::cerr << "[StreamProcessor] 编码失败: " << e.what() << std::endl;
+                }
+            }
         }
+        cam.frameStore.retire(frames); // 帧已送入编码器，按删除策略处理磁盘副本
+        auto elapsed = std::chrono::steady_clock::now() - begin;
+        encodeBatchSeconds->observe(std::chrono::duration<double>(elapsed).count());
+        recordEncode(frames.size(), elapsed);
     }
 
-    void StreamProcessor::processBatchEncoding()
+    void StreamProcessor::releaseInOrder(CameraStream &cam, uint64_t sequence, std::vector<Segment> segments)
     {
-        std::vector<std::string> batch; // 存储一批待编码的文件
-        while (true)
+        std::lock_guard<std::mutex> lock(cam.orderMutex);
+        cam.completed[sequence] = std::move(segments);
+        auto it = cam.completed.begin();
+        while (it != cam.completed.end() && it->first == cam.nextRelease)
+        {
+            for (auto &segment : it->second)
+                enqueueSegment(std::move(segment));
+            it = cam.completed.erase(it);
+            ++cam.nextRelease;
+        }
+    }
+
+    void StreamProcessor::recordEncode(size_t frames, std::chrono::steady_clock::duration elapsed)
+    {
+        encodedFrames += frames;
+        encodeBusyUs += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    }
+
+    void StreamProcessor::enqueueSegment(Segment segment)
+    {
+        ++encodedSegments;
+        std::cout << "[StreamProcessor] Pushing file to uploadQueue: " << segment.path << std::endl; // 打印推送文件名
+        Segment evicted;
+        auto result = uploadQueue.push(segment, &evicted); // 将编码后的分段加入上传队列
+        if (result == PushResult::DroppedOldest)
         {
-            auto file = frameQueue->pop(); // 从队列中取出文件
-            if (file.empty())              // 如果队列为空，则退出
-                break;
-            batch.push_back(file); // 将文件加入批次
+            std::cerr << "[StreamProcessor] 上传队列已满，最旧的文件转入spool: " << evicted.path << std::endl;
+            spoolSegment(evicted);
         }
+        else if (result == PushResult::Rejected || result == PushResult::Closed)
+        {
+            std::cerr << "[StreamProcessor] 上传队列不接受新文件，转入spool: " << segment.path << std::endl;
+            spoolSegment(segment);
+        }
+    }
+
+    void StreamProcessor::spoolSegment(const Segment &segment)
+    {
+        if (spool.add(segment))
+        {
+            ++spooled;
+            return;
+        }
+        ++uploadDropped;
+        std::remove(segment.path.c_str());
+    }
+
+    void StreamProcessor::registerMetrics()
+    {
+        // 计数器和队列深度在导出时读取，采集线程上只有原有的原子自增
+        metrics.counter("videostreamer_frames_captured_total", "Frames received from the frame source",
+                        [this]() { return static_cast<double>(captured); });
+        metrics.counter("videostreamer_frames_capture_dropped_total", "Frames dropped because the capture queue was full",
+                        [this]() { return static_cast<double>(captureDropped); });
+        metrics.counter("videostreamer_frames_lost_total", "Frames missing from the camera's hardware frame numbers",
+                        [this]()
+                        {
+                            uint64_t total = 0;
+                            for (const auto &cam : cameras)
+                                total += cam->camera.droppedFrames();
+                            return static_cast<double>(total);
+                        });
+        metrics.counter("videostreamer_frames_rate_dropped_total", "Frames skipped by the adaptive frame-rate controller",
+                        [this]() { return static_cast<double>(rateDropped); });
+        metrics.counter("videostreamer_frames_static_skipped_total", "Frames skipped by motion detection while the scene was static",
+                        [this]() { return static_cast<double>(staticSkipped); });
+        metrics.counter("videostreamer_frames_stored_total", "Frames written to the frame store",
+                        [this]() { return static_cast<double>(stored); });
+        metrics.counter("videostreamer_frames_store_dropped_total", "Frames evicted or rejected by the frame store",
+                        [this]() { return static_cast<double>(storeDropped); });
+        metrics.counter("videostreamer_segments_encoded_total", "Segments produced by the encoder",
+                        [this]() { return static_cast<double>(encodedSegments); });
+        metrics.counter("videostreamer_encode_failures_total", "Failed encode batches or frames",
+                        [this]() { return static_cast<double>(encodeFailed); });
+        metrics.counter("videostreamer_segments_uploaded_total", "Segments uploaded to OSS",
+                        [this]() { return static_cast<double>(uploaded); });
+        metrics.counter("videostreamer_upload_bytes_total", "Bytes uploaded to OSS",
+                        [this]() { return static_cast<double>(uploadedBytes); });
+        metrics.counter("videostreamer_upload_failures_total", "Failed upload attempts",
+                        [this]() { return static_cast<double>(uploadFailed); });
+        metrics.counter("videostreamer_upload_dropped_total", "Segments dropped without upload",
+                        [this]() { return static_cast<double>(uploadDropped); });
+        metrics.counter("videostreamer_segments_spooled_total", "Segments written to the retry spool",
+                        [this]() { return static_cast<double>(spooled); });
 
-        if (!batch.empty()) // 如果批次非空
+        // 各摄像头的队列深度取总和
+        auto sumCameras = [this](size_t (*value)(const CameraStream &))
         {
-            char outputFile[128];
-            snprintf(outputFile, sizeof(outputFile), "%sout_%ld.h264", // 生成输出文件名
-                     config.tempDir.c_str(),
-                     std::chrono::high_resolution_clock::now()
-                         .time_since_epoch()
-                         .count());
-            
-            std::cout << "[StreamProcessor] Pushing file to uploadQueue: " << outputFile << std::endl; // 打印推送文件名
-            encoder.encode(batch, outputFile);                                                         // 执行编码
+            return [this, value]()
+            {
+                size_t total = 0;
+                for (const auto &cam : cameras)
+                    total += value(*cam);
+                return static_cast<double>(total);
+            };
+        };
+        metrics.gauge("videostreamer_cameras", "Cameras handled by this process",
+                      [this]() { return static_cast<double>(cameras.size()); });
+        metrics.gauge("videostreamer_capture_queue_depth", "Frames waiting in the capture hand-off queues",
+                      sumCameras([](const CameraStream &cam) { return cam.captureQueue.size(); }));
+        metrics.gauge("videostreamer_frame_store_depth", "Frames waiting to be encoded",
+                      sumCameras([](const CameraStream &cam) { return cam.frameStore.size(); }));
+        metrics.gauge("videostreamer_frame_store_bytes", "Bytes of frames held in memory by the frame stores",
+                      sumCameras([](const CameraStream &cam) { return cam.frameStore.memoryBytes(); }));
+        metrics.gauge("videostreamer_coalesce_pending_bytes", "Bytes held in coalescing buffers waiting to be uploaded",
+                      [this]() { return coalescer ? static_cast<double>(coalescer->pendingBytes()) : 0.0; });
+        metrics.gauge("videostreamer_upload_rate_limit_bytes", "Current upload bandwidth cap in bytes per second, 0 if unlimited",
+                      [this]() { return static_cast<double>(uploader.bandwidth().currentRate()); });
+        metrics.counter("videostreamer_upload_live_throttled_seconds_total", "Time uploads of fresh segments waited for bandwidth",
+                        [this]() { return uploader.bandwidth().waitedUs(UploadLane::Live) / 1e6; });
+        metrics.counter("videostreamer_upload_backlog_throttled_seconds_total", "Time uploads of spooled segments waited for bandwidth",
+                        [this]() { return uploader.bandwidth().waitedUs(UploadLane::Backlog) / 1e6; });
+        metrics.gauge("videostreamer_upload_queue_depth", "Segments waiting in the upload queue",
+                      [this]() { return static_cast<double>(uploadQueue.size()); });
+        metrics.gauge("videostreamer_spool_segments", "Segments waiting in the retry spool",
+                      [this]() { return static_cast<double>(spool.size()); });
+        metrics.gauge("videostreamer_spool_bytes", "Bytes held in the retry spool",
+                      [this]() { return static_cast<double>(spool.bytes()); });
+        metrics.gauge("videostreamer_scenes_active", "Cameras with motion detected within motionHoldMs",
+                      sumCameras([](const CameraStream &cam) -> size_t
+                                 { return cam.motionDetector && cam.motionDetector->active() ? 1 : 0; }));
+        metrics.counter("videostreamer_live_packets_sent_total", "Packets sent to the live output",
+                        sumCameras([](const CameraStream &cam) -> size_t
+                                   {
+                                       const EncodingSession *session = cam.renditions.front().session.get();
+                                       return session && session->live() ? session->live()->sentPackets() : 0;
+                                   }));
+        metrics.counter("videostreamer_live_packets_dropped_total", "Packets dropped by the live output to avoid blocking",
+                        sumCameras([](const CameraStream &cam) -> size_t
+                                   {
+                                       const EncodingSession *session = cam.renditions.front().session.get();
+                                       return session && session->live() ? session->live()->droppedPackets() : 0;
+                                   }));
+        metrics.counter("videostreamer_events_total", "Events recorded in event recording mode",
+                        sumCameras([](const CameraStream &cam) -> size_t
+                                   { return cam.eventRecorder ? cam.eventRecorder->events() : 0; }));
+        metrics.gauge("videostreamer_cameras_recording", "Cameras currently recording an event",
+                      sumCameras([](const CameraStream &cam) -> size_t
+                                 { return cam.eventRecorder && cam.eventRecorder->recording() ? 1 : 0; }));
+        metrics.gauge("videostreamer_preroll_bytes", "Bytes held in the event pre-roll windows",
+                      sumCameras([](const CameraStream &cam) -> size_t
+                                 { return cam.eventRecorder ? cam.eventRecorder->windowBytes() : 0; }));
+        metrics.gauge("videostreamer_encode_workers", "Number of encode threads",
+                      [this]() { return static_cast<double>(encodeWorkers.load()); });
+        metrics.gauge("videostreamer_encode_capacity_fps", "Estimated encode capacity in frames per second",
+                      [this]() { return stats().encodeCapacityFps; });
+        metrics.gauge("videostreamer_encode_keeping_up", "1 if encode capacity covers targetFPS for all cameras",
+                      [this]() { return stats().encodeKeepingUp ? 1.0 : 0.0; });
+        metrics.gauge("videostreamer_encoder_bitrate_bps", "Current target encoder bitrate",
+                      [this]() { return static_cast<double>(rateController.bitRate()); });
+        metrics.gauge("videostreamer_capture_fps", "Current target capture frame rate",
+                      [this]() { return rateController.frameRate(); });
 
-            uploadQueue.push(outputFile); // 将编码后的文件加入上传队列
+        frameWriteSeconds = &metrics.histogram(
+            "videostreamer_frame_write_seconds", "Time to store one frame (including disk writes)",
+            {0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5});
+        encodeBatchSeconds = &metrics.histogram(
+            "videostreamer_encode_batch_seconds", "Time to encode one batch of frames",
+            {0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5});
+        uploadSeconds = &metrics.histogram(
+            "videostreamer_upload_seconds", "Time to upload one segment, successful or not",
+            {0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60});
+        glassToCloudSeconds = &metrics.histogram(
+            "videostreamer_glass_to_cloud_seconds", "Time from capture of a segment's first frame to upload completion",
+            {1, 2, 5, 10, 20, 30, 60, 120, 300, 600});
+    }
+
+    void StreamProcessor::reportStats() const
+    {
+        auto s = stats();
+        std::cout << "[StreamProcessor] 采集 " << s.captured << " 帧 (丢弃 " << s.captureDropped << "，设备端丢失 " << s.captureLost << ")"
+                  << "，存储 " << s.stored << " 帧 (丢弃 " << s.storeDropped << ")"
+                  << "，编码 " << s.encodedSegments << " 段 (失败 " << s.encodeFailed << ")"
+                  << "，上传 " << s.uploaded << " 个 (失败 " << s.uploadFailed << "，丢弃 " << s.uploadDropped << ")"
+                  << "，spool " << s.spooled << " 个 (积压 " << s.spoolBacklog << ")"
+                  << "，码率 " << s.bitRate << " bps，帧率 " << s.frameRate << " fps (降帧跳过 " << s.rateDropped << ")"
+                  << "，静止跳过 " << s.staticSkipped << " 帧"
+                  << "，事件 " << s.events << " 次"
+                  << std::endl;
+        std::cout << "[StreamProcessor] 编码线程 " << s.encodeWorkers << " 个，编码能力 " << s.encodeCapacityFps
+                  << " fps，目标 " << s.requiredFps << " fps，" << (s.encodeKeepingUp ? "跟得上" : "跟不上")
+                  << std::endl;
+        for (const auto &cam : cameras)
+        {
+            std::cout << "[StreamProcessor] 摄像头 " << (cam->config.cameraSerial.empty() ? "-" : cam->config.cameraSerial)
+                      << " 共采集 " << cam->camera.frameCount() << " 帧，平均帧率 "
+                      << cam->camera.averageFps() << " fps" << std::endl;
         }
     }
 
     void StreamProcessor::cleanup()
     {
-        for (auto &t : workers)
+        eventServer.stop();
+        // 按流水线顺序依次停止各阶段，前一阶段结束后后一阶段会处理完剩余数据
+        for (auto &cam : cameras)
+        {
+            if (cam->callbackCapture)
+            {
+                // 停止数据流后不再有回调，之后帧存储线程取完剩余的帧即可退出
+                cam->camera.stop();
+                cam->captureDone = true;
+                cam->captureReady.notify_one();
+            }
+            if (cam->captureThread.joinable())
+                cam->captureThread.join();
+        }
+        for (auto &cam : cameras)
+        {
+            if (cam->storeThread.joinable())
+                cam->storeThread.join();
+            cam->frameStore.close();
+        }
+        encodeReady.notify_all();
+        for (auto &t : encodeThreads)
         {
-            if (t.joinable()) // 如果线程可连接，则连接线程
+            if (t.joinable())
                 t.join();
         }
+        encodeThreads.clear();
+
+        uploadQueue.close(); // 唤醒等待中的上传线程
+        if (uploadThread.joinable())
+            uploadThread.join(); // 返回时在途的上传均已完成
         clearTempFiles(); // 清理临时文件
+
+        reportStats();
+        metricsExporter.stop();
     }
 
     void StreamProcessor::clearTempFiles()
     {
-        while (true)
-        {
-            auto file = frameQueue->pop(); // 从帧队列中取出文件并删除
-            if (file.empty())
-                break;
-            std::remove(file.c_str());
-        }
-        while (true)
+        for (auto &cam : cameras)
+            cam->frameStore.clear(); // 清空帧缓冲区并删除磁盘副本
+        Segment segment;
+        while (uploadQueue.tryPop(segment)) // 尚未上传的分段写入spool，下次启动时继续上传
         {
-            auto file = uploadQueue.pop(); // 从上传队列中取出文件并删除
-            if (file.empty())
-                break;
-            std::remove(file.c_str());
+            spoolSegment(segment);
         }
     }
-} // namespace VideoStreamer
\ No newline at end of file
+} // namespace VideoStreamer
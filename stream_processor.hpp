@@ -1,26 +1,74 @@
 #pragma once
 #include "config.hpp"
 #include "camera_capture.hpp"
+#include "frame_store.hpp"
 #include "oss_uploader.hpp"
 #include "video_encoder.hpp"
+#include "encoding_session.hpp"
+#include "segment.hpp"
 #include "thread_safe_queue.hpp"
+#include "upload_spool.hpp"
+#include "rate_controller.hpp"
+#include "metrics.hpp"
+#include "motion_detector.hpp"
+#include "event_recorder.hpp"
+#include "segment_coalescer.hpp"
+#include "lock_free_queue.hpp"
 #include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
 #include <vector>
 #include <memory>
 #include <thread>
 
 namespace VideoStreamer
 {
+    /**
+     * 各处理阶段的统计信息（快照）
+     */
+    struct StageStats
+    {
+        uint64_t captured = 0;        // 采集到的帧数
+        uint64_t captureDropped = 0;  // 采集队列已满而丢弃的帧数
+        uint64_t captureLost = 0;     // 按设备帧号检测到、未到达本进程的帧数
+        uint64_t rateDropped = 0;     // 自适应降帧率而跳过的帧数
+        uint64_t staticSkipped = 0;   // 画面静止而跳过的帧数
+        uint64_t events = 0;          // 已录制的事件数（事件录制模式）
+        uint64_t stored = 0;          // 存入帧缓冲区的帧数
+        uint64_t storeDropped = 0;    // 帧缓冲区超出上限或溢出帧读回失败而丢弃的帧数
+        uint64_t encodedSegments = 0; // 编码完成的分段数
+        uint64_t encodeFailed = 0;    // 编码失败的批次/帧数
+        uint64_t uploadDropped = 0;   // 上传队列已满而丢弃的文件数
+        uint64_t uploaded = 0;        // 上传成功的文件数
+        uint64_t uploadFailed = 0;    // 上传失败的文件数
+        uint64_t spooled = 0;         // 写入spool等待重试的分段数
+        uint64_t spoolBacklog = 0;    // spool中积压的分段数
+        int64_t bitRate = 0;          // 当前编码码率
+        double frameRate = 0.0;       // 当前采集帧率
+        int encodeWorkers = 0;        // 编码线程数
+        double encodeCapacityFps = 0.0; // 按实测编码耗时估算的编码能力（帧/秒，所有编码线程合计）
+        double requiredFps = 0.0;     // 所有摄像头按目标帧率需要的编码速度（帧/秒）
+        bool encodeKeepingUp = true;  // 编码能力是否跟得上目标帧率
+    };
+
     /**
      * StreamProcessor类，用于处理视频流的捕获、编码、上传等任务
+     * 流水线分为 采集 -> 帧存储 -> 编码 -> 上传 四个阶段，阶段之间通过有界队列交接；
+     * 每个摄像头有各自的采集和帧存储线程，编码由所有摄像头共享的线程池完成，上传共享同一个上传器；
+     * 采集线程永远不会因编码或上传而阻塞
      */
     class StreamProcessor
     {
     public:
         StreamProcessor(const AppConfig &cfg);
+        ~StreamProcessor();
 
         /**
-         * 启动视频流处理
+         * 启动视频流处理（启动各阶段线程后立即返回）
          */
         void start();
 
@@ -29,51 +77,172 @@ namespace VideoStreamer
          */
         void stop();
 
+        /**
+         * 获取各阶段的统计信息
+         */
+        StageStats stats() const;
+
+        /**
+         * 触发事件录制（可在任意线程调用）：cameraSerial为空时触发所有摄像头
+         * 未处于事件录制模式或没有匹配的摄像头时返回false
+         */
+        bool triggerEvent(const std::string &cameraSerial = "");
+
     private:
         /**
-         * 设置上传工作线程
+         * 上传阶段：取出待上传分段并异步提交给共享上传器，同时在途的上传数不超过uploadThreads
+         * 启用分段合并时，新分段先进入合并缓冲，合并好的对象再上传（spool中的积压不合并）
+         */
+        void uploadLoop();
+
+        /**
+         * 取出下一个待上传的分段：新分段优先，其次是spool中已到重试时间的积压（allowBacklog为false时不取积压）
+         * 队列关闭且为空时返回false
+         */
+        bool nextUpload(Segment &segment, bool &fromSpool, bool allowBacklog);
+
+        /**
+         * 异步上传完成的处理（在上传器的请求线程上调用）
+         */
+        void onUploadComplete(const Segment &segment, bool fromSpool, bool ok,
+                              std::chrono::steady_clock::duration elapsed);
+
+        /**
+         * 单个摄像头的采集、帧存储和编码状态
+         * 编码线程处理某个摄像头前先通过claimed独占它，同一摄像头的帧始终按顺序编码
+         */
+        // 编码阶梯中的一路输出
+        struct RenditionStream
+        {
+            Rendition rendition;                       // 档位配置（bitRate为自适应调整的基准）
+            std::string uploadPrefix;                  // 该档位的OSS对象前缀（摄像头前缀 + 档位子路径）
+            std::unique_ptr<EncodingSession> session;  // 连续编码会话（连续模式），批次模式下为空
+            uint64_t nextSequence = 0;                 // 连续模式下该档位下一个分段的序号
+        };
+
+        struct CameraStream
+        {
+            explicit CameraStream(const AppConfig &cfg);
+
+            /**
+             * 是否为连续编码（各档位有长期存在的编码会话）
+             */
+            bool continuous() const { return renditions.front().session != nullptr; }
+
+            // captureQueue按缓存行对齐，C++14的new不保证扩展对齐，由类自己分配对齐的内存
+            static void *operator new(size_t size)
+            {
+                void *ptr = nullptr;
+                if (posix_memalign(&ptr, detail::CacheLine, size) != 0)
+                    throw std::bad_alloc();
+                return ptr;
+            }
+            static void operator delete(void *ptr) { free(ptr); }
+
+            AppConfig config;                          // 该摄像头的配置（序列号、对象前缀、临时目录）
+            CameraCapture camera;                      // 摄像头捕获对象
+            SpscQueue<FramePtr> captureQueue;          // 采集阶段到帧存储阶段的无锁交接队列
+            std::mutex captureMutex;
+            std::condition_variable captureReady;
+            std::atomic<bool> captureDone{false};
+            bool callbackCapture = false;              // 以SDK回调方式采集（没有采集线程）
+            std::unique_ptr<MotionDetector> motionDetector; // 运动检测（motionDetection启用时创建，仅帧存储线程访问）
+            std::unique_ptr<EventRecorder> eventRecorder;   // 事件录制的历史窗口（事件录制模式下创建）
+            std::atomic<bool> eventEnded{false};       // 一次事件刚结束，编码线程应冲刷不足一个分段的剩余帧
+            FrameStore frameStore;                     // 待编码帧的环形缓冲区
+            std::vector<RenditionStream> renditions;   // 编码阶梯的各档位（直通模式只有一个）
+            std::unique_ptr<PictureLadder> pictures;   // 连续编码时各档位共享的解码/缩放（直通模式和批次模式下为空）
+            int64_t appliedBitRate;                    // 编码会话当前使用的码率（对应配置的bitRate）
+            double frameCredit = 0.0;                  // 自适应帧率的抽帧累加器（仅采集线程或SDK回调线程访问）
+            std::atomic<bool> claimed{false};          // 是否有编码线程正在处理该摄像头
+            bool finished = false;                     // 帧已全部取出编码（连续模式下编码器已冲刷）
+            uint64_t nextSequence = 0;                 // 批次模式下一个批次的序号（持有claimed时分配）
+
+            // 排序阶段：并行编码的批次可能乱序完成，按序号依次交给上传队列
+            std::mutex orderMutex;
+            uint64_t nextRelease = 0;                  // 下一个应交给上传队列的序号
+            std::map<uint64_t, std::vector<Segment>> completed; // 已完成但前面还有未完成序号的批次（各档位的分段，为空表示编码失败）
+            std::thread captureThread;
+            std::thread storeThread;
+        };
+
+        /**
+         * 采集阶段（轮询方式）：从摄像头获取帧并无阻塞地交给帧存储阶段
          */
-        void setupUploadWorkers();
+        void captureLoop(CameraStream &cam);
 
         /**
-         * 处理上传任务
+         * 把采集到的一帧交给帧存储阶段（自适应抽帧，队列满时丢弃），不阻塞
+         * 轮询方式在采集线程上调用，回调方式在SDK的回调线程上调用
          */
-        void processUpload(OSSUploader &uploader);
+        void deliverFrame(CameraStream &cam, FramePtr frame);
 
         /**
-         * 启动视频帧处理循环
+         * 帧存储阶段：运动分析（可选，静止画面抽帧）后将帧存入帧缓冲区（可能写入磁盘）；
+         * 事件录制模式下空闲时帧只进入历史窗口，触发后才存入帧缓冲区
          */
-        void startProcessingLoop();
+        void storeLoop(CameraStream &cam);
 
         /**
-         * 处理视频帧
+         * 编码线程主循环：轮流处理各摄像头已就绪的帧，所有摄像头结束后退出
          */
-        void processFrame(int &frameCounter);
+        void encodeLoop();
 
         /**
-         * 处理新的视频帧
+         * 连续模式：把一个摄像头已就绪的帧送入编码会话（调用方已独占该摄像头），有工作可做时返回true
          */
-        void handleNewFrame(std::shared_ptr<ob::ColorFrame> frame, int &counter);
+        bool encodeCamera(CameraStream &cam);
 
         /**
-         * 保存临时帧到文件
+         * 批次模式：取出一个摄像头的下一批帧并分配序号（调用方已独占该摄像头），取到时返回true
          */
-        std::string saveTempFrame(std::shared_ptr<ob::ColorFrame> frame);
+        bool takeBatch(CameraStream &cam, std::vector<FramePtr> &batch, uint64_t &sequence);
 
         /**
-         * 管理视频帧队列，确保队列大小不超过配置的最大值
+         * 根据上传积压更新自适应码率，并把新码率应用到该摄像头的编码会话（编码线程调用）
          */
-        void manageFrameQueue(const std::string &filename);
+        void applyRateControl(CameraStream &cam);
 
         /**
-         * 检查是否需要批量编码
+         * 执行批量编码处理（不需要独占摄像头，同一摄像头的多个批次可在不同编码线程上并行）
          */
-        void checkBatchEncoding(int counter);
+        void processBatchEncoding(CameraStream &cam, VideoEncoder &encoder, std::vector<FramePtr> batch,
+                                  uint64_t sequence);
 
         /**
-         * 执行批量编码处理
+         * 将连续编码会话中的帧送入编码器
          */
-        void processBatchEncoding();
+        void processContinuousEncoding(CameraStream &cam, std::vector<FramePtr> frames);
+
+        /**
+         * 排序阶段：登记一个已完成（或失败）的批次，并按序号把连续批次的分段交给上传队列
+         */
+        void releaseInOrder(CameraStream &cam, uint64_t sequence, std::vector<Segment> segments);
+
+        /**
+         * 记录一次编码的帧数和耗时，用于估算编码能力
+         */
+        void recordEncode(size_t frames, std::chrono::steady_clock::duration elapsed);
+
+        /**
+         * 将编码完成的分段（已带上档位的对象前缀）加入上传队列
+         */
+        void enqueueSegment(Segment segment);
+
+        /**
+         * 将无法立即上传的分段写入spool，写入失败时丢弃
+         */
+        void spoolSegment(const Segment &segment);
+
+        /**
+         * 登记各阶段的指标
+         */
+        void registerMetrics();
+
+        /**
+         * 打印各阶段统计信息
+         */
+        void reportStats() const;
 
         /**
          * 清理工作，停止线程等
@@ -81,29 +250,75 @@ namespace VideoStreamer
         void cleanup();
 
         /**
-         * 清除临时文件
+         * 清除临时文件（尚未上传的分段转入spool）
          */
         void clearTempFiles();
 
         // 配置参数
         AppConfig config;
 
-        // 摄像头捕获对象
-        CameraCapture camera;
+        // 运行状态标志
+        std::atomic<bool> running{false};
 
-        // 视频编码器对象
-        VideoEncoder encoder;
+        // 各摄像头（创建后不再增减）
+        std::vector<std::unique_ptr<CameraStream>> cameras;
 
-        // 运行状态标志
-        std::atomic<bool> running{true};
+        // 帧存储线程存入新帧后唤醒空闲的编码线程
+        std::mutex encodeMutex;
+        std::condition_variable encodeReady;
+
+        // 存储待上传分段的队列
+        ThreadSafeQueue<Segment> uploadQueue;
+
+        // 共享的OSS上传器（单个客户端和连接池）
+        OSSUploader uploader;
+
+        // 上传失败分段的持久化缓存
+        UploadSpool spool;
+
+        // 上传端的分段合并（coalesceSegments启用时创建，仅上传线程访问）
+        std::unique_ptr<SegmentCoalescer> coalescer;
+
+        // 自适应码率/帧率控制器
+        RateController rateController;
+
+        // 事件触发的本地套接字
+        EventTriggerServer eventServer;
+
+        // 编码线程池和上传线程（采集/帧存储线程属于各摄像头）
+        std::vector<std::thread> encodeThreads;
+        std::atomic<int> encodeWorkers{0};
+        std::thread uploadThread;
 
-        // 存储视频帧的队列
-        std::shared_ptr<ThreadSafeQueue<std::string>> frameQueue;
+        // 在途的异步上传数
+        std::mutex uploadMutex;
+        std::condition_variable uploadDone;
+        size_t uploadsInFlight = 0;
+        size_t backlogInFlight = 0; // 其中来自spool的上传数
 
-        // 存储待上传文件的队列
-        ThreadSafeQueue<std::string> uploadQueue;
+        // 各阶段统计计数
+        std::atomic<uint64_t> captured{0};
+        std::atomic<uint64_t> captureDropped{0};
+        std::atomic<uint64_t> rateDropped{0};
+        std::atomic<uint64_t> staticSkipped{0};
+        std::atomic<uint64_t> stored{0};
+        std::atomic<uint64_t> storeDropped{0};
+        std::atomic<uint64_t> encodedSegments{0};
+        std::atomic<uint64_t> encodeFailed{0};
+        std::atomic<uint64_t> uploadDropped{0};
+        std::atomic<uint64_t> uploaded{0};
+        std::atomic<uint64_t> uploadFailed{0};
+        std::atomic<uint64_t> spooled{0};
+        std::atomic<uint64_t> uploadedBytes{0};
+        std::atomic<uint64_t> encodedFrames{0};   // 已编码的帧数
+        std::atomic<uint64_t> encodeBusyUs{0};    // 所有编码线程的编码耗时之和（微秒）
 
-        // 工作线程池
-        std::vector<std::thread> workers;
+        // 指标登记表与导出器（导出器引用登记表，需在其后声明）
+        MetricsRegistry metrics;
+        Histogram *frameWriteSeconds = nullptr;   // 帧写入帧缓冲区（可能写盘）的耗时
+        Histogram *encodeBatchSeconds = nullptr;  // 每批帧的编码耗时
+        Histogram *uploadSeconds = nullptr;       // 每个分段的上传耗时
+        Histogram *glassToCloudSeconds = nullptr; // 分段第一帧采集到上传完成的延迟
+        MetricsExporter metricsExporter;
     };
-} // namespace VideoStreamer
\ No newline at end of file
+} // namespace VideoStreamer
@@ -1,35 +1,166 @@
 #pragma once
-#include <queue>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <memory>
+#include <vector>
 
 namespace VideoStreamer
 {
-    // 模板类：线程安全的队列
+    /**
+     * 队列已满时的处理策略
+     */
+    enum class OverflowPolicy {
+        Block = 0,      // 阻塞等待空位
+        DropOldest = 1, // 丢弃最旧的元素
+        Reject = 2      // 拒绝新元素
+    };
+
+    /**
+     * push的结果
+     */
+    enum class PushResult {
+        Ok = 0,         // 成功入队
+        DroppedOldest,  // 成功入队，但丢弃了最旧的元素
+        Rejected,       // 队列已满，新元素被拒绝
+        Closed          // 队列已关闭
+    };
+
+    // 模板类：线程安全的队列，支持容量上限、阻塞/超时出队、批量出队和关闭
     template <typename T>
     class ThreadSafeQueue
     {
     public:
         /**
-         * 将一个值压入队列
+         * capacity为0表示不限容量
          */
-        void push(const T &value)
+        explicit ThreadSafeQueue(size_t capacity = 0, OverflowPolicy policy = OverflowPolicy::Block)
+            : capacity(capacity), policy(policy) {}
+
+        /**
+         * 将一个值压入队列；DropOldest策略下被丢弃的元素通过evicted返回（可为nullptr）
+         */
+        PushResult push(T value, T *evicted = nullptr)
         {
-            std::lock_guard<std::mutex> lock(mutex);
-            queue.push(value);
+            std::unique_lock<std::mutex> lock(mutex);
+            PushResult result = PushResult::Ok;
+            if (capacity > 0 && queue.size() >= capacity && !closed)
+            {
+                switch (policy)
+                {
+                case OverflowPolicy::Block:
+                    notFull.wait(lock, [this]
+                                 { return queue.size() < capacity || closed; });
+                    break;
+                case OverflowPolicy::DropOldest:
+                    if (evicted)
+                        *evicted = std::move(queue.front());
+                    queue.pop_front();
+                    ++dropped;
+                    result = PushResult::DroppedOldest;
+                    break;
+                case OverflowPolicy::Reject:
+                    ++dropped;
+                    return PushResult::Rejected;
+                }
+            }
+            if (closed)
+                return PushResult::Closed;
+
+            queue.push_back(std::move(value));
+            lock.unlock();
+            notEmpty.notify_one();
+            return result;
         }
 
         /**
-         * 从队列中弹出一个值
+         * 从队列中弹出一个值，最多等待timeout；超时或队列已关闭且为空时返回false
          */
-        T pop()
+        template <typename Rep, typename Period>
+        bool pop(T &out, const std::chrono::duration<Rep, Period> &timeout)
         {
-            std::lock_guard<std::mutex> lock(mutex);
+            std::unique_lock<std::mutex> lock(mutex);
+            if (!notEmpty.wait_for(lock, timeout, [this]
+                                   { return !queue.empty() || closed; }) ||
+                queue.empty())
+            {
+                return false;
+            }
+            out = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            notFull.notify_one();
+            return true;
+        }
+
+        /**
+         * 阻塞直到弹出一个值；队列关闭且为空时返回false
+         */
+        bool waitPop(T &out)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [this]
+                          { return !queue.empty() || closed; });
             if (queue.empty())
-                return T();
-            auto val = queue.front();
-            queue.pop();
-            return val;
+                return false;
+            out = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            notFull.notify_one();
+            return true;
+        }
+
+        /**
+         * 非阻塞弹出，队列为空时返回false
+         */
+        bool tryPop(T &out)
+        {
+            return pop(out, std::chrono::milliseconds(0));
+        }
+
+        /**
+         * 批量弹出最多maxItems个值，队列为空时最多等待timeout，返回弹出的数量
+         */
+        template <typename Rep, typename Period>
+        size_t popBatch(std::vector<T> &out, size_t maxItems, const std::chrono::duration<Rep, Period> &timeout)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait_for(lock, timeout, [this]
+                              { return !queue.empty() || closed; });
+            size_t n = 0;
+            while (!queue.empty() && n < maxItems)
+            {
+                out.push_back(std::move(queue.front()));
+                queue.pop_front();
+                ++n;
+            }
+            lock.unlock();
+            if (n > 0)
+                notFull.notify_all();
+            return n;
+        }
+
+        /**
+         * 关闭队列：唤醒所有等待者，之后的push返回Closed，剩余元素仍可弹出
+         */
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+            }
+            notEmpty.notify_all();
+            notFull.notify_all();
+        }
+
+        /**
+         * 队列是否已关闭
+         */
+        bool isClosed() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return closed;
         }
 
         /**
@@ -41,8 +172,23 @@ namespace VideoStreamer
             return queue.size();
         }
 
+        /**
+         * 因队列已满而丢弃（或拒绝）的元素数量
+         */
+        size_t droppedCount() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return dropped;
+        }
+
     private:
-        std::queue<T> queue;    // 存储队列元素
+        std::deque<T> queue;    // 存储队列元素
+        size_t capacity;        // 容量上限（0为不限）
+        OverflowPolicy policy;  // 队列已满时的策略
+        size_t dropped = 0;     // 丢弃/拒绝计数
+        bool closed = false;    // 是否已关闭
         mutable std::mutex mutex;   // 保护队列的线程安全
+        std::condition_variable notEmpty; // 队列非空通知
+        std::condition_variable notFull;  // 队列未满通知
     };
-} // namespace VideoStreamer
\ No newline at end of file
+} // namespace VideoStreamer
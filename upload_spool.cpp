@@ -0,0 +1,480 @@
+#include "upload_spool.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace VideoStreamer
+{
+    namespace
+    {
+        const char *kJournalName = "journal.log";
+        const char *kCheckpointSuffix = ".ucp"; // 与OSSUploader的分片断点文件后缀一致
+        const size_t kCompactDeletes = 1024;    // journal累计这么多条del记录后压缩，长时间运行时不无限增长
+
+        int64_t toMicros(std::chrono::system_clock::time_point t)
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+        }
+
+        std::chrono::system_clock::time_point fromMicros(int64_t us)
+        {
+            return std::chrono::system_clock::time_point(std::chrono::microseconds(us));
+        }
+
+        std::string baseName(const std::string &path)
+        {
+            auto pos = path.find_last_of('/');
+            return pos == std::string::npos ? path : path.substr(pos + 1);
+        }
+
+        bool endsWith(const std::string &s, const std::string &suffix)
+        {
+            return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+
+        // 解析journal中的无符号整数字段，必须整个字段都是数字，格式错误或越界时返回false
+        bool parseUnsigned(const std::string &text, uint64_t &value)
+        {
+            if (text.empty() || text[0] < '0' || text[0] > '9')
+                return false;
+            char *end = nullptr;
+            errno = 0;
+            unsigned long long parsed = std::strtoull(text.c_str(), &end, 10);
+            if (errno == ERANGE || *end != '\0')
+                return false;
+            value = parsed;
+            return true;
+        }
+
+        // 解析journal中的浮点字段，格式错误时返回false
+        bool parseFloat(const std::string &text, float &value)
+        {
+            if (text.empty())
+                return false;
+            char *end = nullptr;
+            errno = 0;
+            float parsed = std::strtof(text.c_str(), &end);
+            if (errno == ERANGE || *end != '\0')
+                return false;
+            value = parsed;
+            return true;
+        }
+
+        // 写入整个缓冲并fsync，成功返回true
+        bool writeFileSync(const std::string &path, const uint8_t *data, size_t size)
+        {
+            int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+                return false;
+            size_t written = 0;
+            while (written < size)
+            {
+                ssize_t n = write(fd, data + written, size - written);
+                if (n < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    close(fd);
+                    return false;
+                }
+                written += static_cast<size_t>(n);
+            }
+            bool ok = fsync(fd) == 0;
+            close(fd);
+            return ok;
+        }
+
+        // 将已有文件刷到磁盘
+        bool fsyncFile(const std::string &path)
+        {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            bool ok = fsync(fd) == 0;
+            close(fd);
+            return ok;
+        }
+
+        // 移动文件：优先rename，跨文件系统时复制后删除源文件
+        bool moveFile(const std::string &from, const std::string &to)
+        {
+            if (rename(from.c_str(), to.c_str()) == 0)
+                return fsyncFile(to);
+            if (errno != EXDEV)
+                return false;
+
+            std::ifstream in(from, std::ios::binary);
+            std::vector<uint8_t> content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            if (!in.good() && !in.eof())
+                return false;
+            if (!writeFileSync(to, content.data(), content.size()))
+                return false;
+            std::remove(from.c_str());
+            return true;
+        }
+
+        std::string journalAddLine(const Segment &segment)
+        {
+            std::ostringstream line;
+            line << "add " << baseName(segment.path) << " " << segment.extension << " " << segment.bytes << " "
+                 << segment.frameCount << " " << toMicros(segment.startTime) << " " << toMicros(segment.endTime);
+            if (segment.analyzedFrames > 0)
+                line << " " << segment.analyzedFrames << " " << segment.motionFrames << " " << segment.motionPeak;
+            if (!segment.objectPrefix.empty())
+                line << " prefix=" << segment.objectPrefix;
+            line << " seq=" << segment.sequence;
+            if (segment.headerBytes > 0)
+                line << " hdr=" << segment.headerBytes;
+            if (!segment.keyframes.empty())
+                line << " idx=" << segment.indexString();
+            return line.str();
+        }
+    } // namespace
+
+    UploadSpool::UploadSpool(const AppConfig &cfg) : config(cfg), rng(std::random_device{}())
+    {
+        if (!config.spoolDir.empty() && config.spoolDir.back() != '/')
+        {
+            config.spoolDir += '/';
+        }
+        if (mkdir(config.spoolDir.c_str(), 0755) != 0 && errno != EEXIST)
+        {
+            throw std::runtime_error("[UploadSpool] spool目录创建失败: " + config.spoolDir + ": " + strerror(errno));
+        }
+
+        recover();
+    }
+
+    UploadSpool::~UploadSpool()
+    {
+        if (journalFd >= 0)
+            close(journalFd);
+    }
+
+    void UploadSpool::recover()
+    {
+        // 重放journal：add记录加入积压，del记录移除；崩溃时写了一半的最后一行解析失败后忽略
+        std::map<std::string, Segment> pending;
+        std::vector<std::string> order;
+        std::ifstream journal(config.spoolDir + kJournalName);
+        std::string line;
+        while (std::getline(journal, line))
+        {
+            std::istringstream fields(line);
+            std::string op, name;
+            if (!(fields >> op >> name))
+                continue;
+            if (op == "add")
+            {
+                Segment segment;
+                int64_t startUs = 0, endUs = 0;
+                if (!(fields >> segment.extension >> segment.bytes >> segment.frameCount >> startUs >> endUs))
+                    continue;
+                // 可选字段：活动信息（三个数值）、对象前缀（prefix=...）、分段序号（seq=...）
+                // 以及关键帧索引（hdr=...、idx=...）
+                segment.startTime = fromMicros(startUs);
+                std::string extra;
+                std::vector<std::string> activity;
+                bool valid = true;
+                while (valid && fields >> extra)
+                {
+                    if (extra.compare(0, 7, "prefix=") == 0)
+                        segment.objectPrefix = extra.substr(7);
+                    else if (extra.compare(0, 4, "seq=") == 0)
+                        valid = parseUnsigned(extra.substr(4), segment.sequence);
+                    else if (extra.compare(0, 4, "hdr=") == 0)
+                        valid = parseUnsigned(extra.substr(4), segment.headerBytes);
+                    else if (extra.compare(0, 4, "idx=") == 0)
+                        valid = segment.parseIndex(extra.substr(4));
+                    else
+                        activity.push_back(extra);
+                }
+                if (valid && activity.size() == 3)
+                {
+                    uint64_t analyzed = 0, motion = 0;
+                    valid = parseUnsigned(activity[0], analyzed) && parseUnsigned(activity[1], motion) &&
+                            parseFloat(activity[2], segment.motionPeak);
+                    segment.analyzedFrames = static_cast<size_t>(analyzed);
+                    segment.motionFrames = static_cast<size_t>(motion);
+                }
+                // 字段损坏的记录（例如崩溃时写了一半）与格式错误的行一样跳过，不中断启动
+                if (!valid)
+                    continue;
+                segment.path = config.spoolDir + name;
+                segment.endTime = fromMicros(endUs);
+                if (!pending.count(name))
+                    order.push_back(name);
+                pending[name] = segment;
+            }
+            else if (op == "del")
+            {
+                pending.erase(name);
+            }
+        }
+
+        // 扫描目录：文件已写入但journal记录尚未落盘的分段同样恢复
+        DIR *dir = opendir(config.spoolDir.c_str());
+        if (dir)
+        {
+            std::vector<std::string> orphans;
+            while (dirent *ent = readdir(dir))
+            {
+                std::string name = ent->d_name;
+                if (name == "." || name == ".." || name == kJournalName || endsWith(name, kCheckpointSuffix) ||
+                    endsWith(name, ".tmp") || pending.count(name))
+                    continue;
+                orphans.push_back(name);
+            }
+            closedir(dir);
+            std::sort(orphans.begin(), orphans.end()); // 文件名包含时间戳，排序后即为时间顺序
+            for (const auto &name : orphans)
+            {
+                Segment segment;
+                segment.path = config.spoolDir + name;
+                auto dot = name.find_last_of('.');
+                segment.extension = dot == std::string::npos ? "" : name.substr(dot);
+                pending[name] = segment;
+                order.push_back(name);
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        for (const auto &name : order)
+        {
+            auto it = pending.find(name);
+            if (it == pending.end())
+                continue;
+            struct stat statBuf;
+            if (stat(it->second.path.c_str(), &statBuf) != 0)
+                continue; // 文件已不存在
+            Entry entry;
+            entry.segment = it->second;
+            entry.segment.bytes = static_cast<size_t>(statBuf.st_size);
+            entry.nextAttempt = now;
+            totalBytes += entry.segment.bytes;
+            entries.push_back(entry);
+            pending.erase(it);
+        }
+
+        compactJournal();
+        enforceBudget();
+        if (!entries.empty())
+        {
+            std::cout << "[UploadSpool] 恢复积压分段 " << entries.size() << " 个，共 " << totalBytes << " 字节" << std::endl;
+        }
+    }
+
+    void UploadSpool::compactJournal()
+    {
+        if (journalFd >= 0)
+        {
+            close(journalFd);
+            journalFd = -1;
+        }
+
+        std::string content;
+        for (const auto &entry : entries)
+        {
+            content += journalAddLine(entry.segment) + "\n";
+        }
+        const std::string path = config.spoolDir + kJournalName;
+        const std::string tmpPath = path + ".tmp";
+        if (!writeFileSync(tmpPath, reinterpret_cast<const uint8_t *>(content.data()), content.size()) ||
+            rename(tmpPath.c_str(), path.c_str()) != 0)
+        {
+            std::cerr << "[UploadSpool] journal压缩失败: " << strerror(errno) << std::endl;
+        }
+
+        journalDeletes = 0;
+        journalFd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (journalFd < 0)
+        {
+            throw std::runtime_error("[UploadSpool] journal打开失败: " + path + ": " + strerror(errno));
+        }
+    }
+
+    void UploadSpool::appendJournal(const std::string &line)
+    {
+        std::string record = line + "\n";
+        if (write(journalFd, record.data(), record.size()) != static_cast<ssize_t>(record.size()) || fsync(journalFd) != 0)
+        {
+            std::cerr << "[UploadSpool] journal写入失败: " << strerror(errno) << std::endl;
+        }
+    }
+
+    bool UploadSpool::add(const Segment &segment)
+    {
+        Segment spooled = segment;
+        spooled.path = config.spoolDir + baseName(segment.path);
+        spooled.data.reset();
+
+        // 先把分段数据完整落盘，再写journal；崩溃时最多留下一个由目录扫描恢复的文件
+        bool ok = segment.inMemory()
+                      ? writeFileSync(spooled.path, segment.data->data(), segment.data->size())
+                      : moveFile(segment.path, spooled.path);
+        if (!ok)
+        {
+            std::cerr << "[UploadSpool] 分段写入spool失败: " << spooled.path << ": " << strerror(errno) << std::endl;
+            std::remove(spooled.path.c_str());
+            return false;
+        }
+        // 分片上传的断点随分段一起移动，重试时只上传缺失的分片
+        std::string checkpoint = segment.path + kCheckpointSuffix;
+        if (access(checkpoint.c_str(), F_OK) == 0)
+            moveFile(checkpoint, spooled.path + kCheckpointSuffix);
+
+        struct stat statBuf;
+        if (stat(spooled.path.c_str(), &statBuf) == 0)
+            spooled.bytes = static_cast<size_t>(statBuf.st_size);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        appendJournal(journalAddLine(spooled));
+        Entry entry;
+        entry.segment = spooled;
+        entry.attempts = 1; // 进入spool前已失败一次
+        entry.nextAttempt = std::chrono::steady_clock::now() + backoff(entry.attempts);
+        totalBytes += spooled.bytes;
+        entries.push_back(entry);
+        enforceBudget();
+        return true;
+    }
+
+    bool UploadSpool::takeDue(Segment &segment)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = std::chrono::steady_clock::now();
+        for (auto &entry : entries)
+        {
+            if (!entry.inFlight && entry.nextAttempt <= now)
+            {
+                entry.inFlight = true;
+                segment = entry.segment;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void UploadSpool::complete(const Segment &segment)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = std::find_if(entries.begin(), entries.end(), [&](const Entry &e)
+                               { return e.segment.path == segment.path; });
+        if (it != entries.end())
+            removeEntry(it);
+    }
+
+    void UploadSpool::recordFailure()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        failing = true;
+    }
+
+    void UploadSpool::recordSuccess()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!failing)
+            return;
+        failing = false;
+
+        // 失败期后的第一次成功：网络已恢复，积压的分段立即重试一次（失败次数保留）
+        auto now = std::chrono::steady_clock::now();
+        for (auto &entry : entries)
+        {
+            entry.nextAttempt = std::min(entry.nextAttempt, now);
+        }
+    }
+
+    void UploadSpool::retryLater(const Segment &segment)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = std::find_if(entries.begin(), entries.end(), [&](const Entry &e)
+                               { return e.segment.path == segment.path; });
+        if (it == entries.end())
+            return; // 上传期间已被淘汰
+
+        if (access(segment.path.c_str(), F_OK) != 0)
+        {
+            std::cerr << "[UploadSpool] 分段文件已丢失，放弃重试: " << segment.path << std::endl;
+            removeEntry(it);
+            return;
+        }
+        it->inFlight = false;
+        it->attempts++;
+        it->nextAttempt = std::chrono::steady_clock::now() + backoff(it->attempts);
+    }
+
+    size_t UploadSpool::size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+
+    uint64_t UploadSpool::bytes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return totalBytes;
+    }
+
+    void UploadSpool::enforceBudget()
+    {
+        auto it = entries.begin();
+        while (config.spoolMaxBytes > 0 && totalBytes > config.spoolMaxBytes && it != entries.end())
+        {
+            if (it->inFlight)
+            {
+                ++it; // 正在上传的分段不淘汰
+                continue;
+            }
+            std::cerr << "[UploadSpool] 超出spool字节上限，淘汰最旧的分段: " << it->segment.path << std::endl;
+            auto victim = it++;
+            removeEntry(victim);
+        }
+    }
+
+    void UploadSpool::removeEntry(std::list<Entry>::iterator it)
+    {
+        std::remove(it->segment.path.c_str());
+        std::remove((it->segment.path + kCheckpointSuffix).c_str());
+        appendJournal("del " + baseName(it->segment.path));
+        totalBytes -= std::min<uint64_t>(totalBytes, it->segment.bytes);
+        entries.erase(it);
+
+        if (++journalDeletes >= kCompactDeletes)
+        {
+            try
+            {
+                compactJournal();
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "[UploadSpool] " << e.what() << std::endl;
+            }
+        }
+    }
+
+    std::chrono::milliseconds UploadSpool::backoff(int attempts)
+    {
+        // 指数退避：base * 2^(attempts-1)，上限retryMaxMs；在[delay/2, delay]内随机抖动，避免多个分段同时重试
+        int64_t delay = std::max(config.retryBaseMs, 1);
+        for (int i = 1; i < attempts && delay < config.retryMaxMs; ++i)
+        {
+            delay *= 2;
+        }
+        delay = std::min<int64_t>(delay, std::max(config.retryMaxMs, 1));
+        std::uniform_int_distribution<int64_t> jitter(delay / 2, delay);
+        return std::chrono::milliseconds(jitter(rng));
+    }
+} // namespace VideoStreamer
@@ -0,0 +1,119 @@
+#pragma once
+#include "config.hpp"
+#include "segment.hpp"
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <random>
+#include <string>
+
+namespace VideoStreamer
+{
+    /**
+     * UploadSpool类，上传失败分段的持久化缓存
+     * 分段文件保存在spoolDir中，增删操作追加到journal（每条记录fsync），
+     * 启动时重放journal并扫描目录恢复积压；失败的分段按指数退避+随机抖动重试，
+     * 总字节数超出spoolMaxBytes时先淘汰最旧的分段
+     */
+    class UploadSpool
+    {
+    public:
+        explicit UploadSpool(const AppConfig &cfg);
+        ~UploadSpool();
+
+        UploadSpool(const UploadSpool &) = delete;
+        UploadSpool &operator=(const UploadSpool &) = delete;
+
+        /**
+         * 将分段写入（或移动到）spool目录并记录到journal，成功返回true
+         */
+        bool add(const Segment &segment);
+
+        /**
+         * 取出一个已到重试时间的分段（最旧的优先），没有时返回false
+         */
+        bool takeDue(Segment &segment);
+
+        /**
+         * 分段上传成功：删除文件和journal记录
+         */
+        void complete(const Segment &segment);
+
+        /**
+         * 新分段上传失败（可能是网络中断）：进入失败期，之后第一次上传成功时视为网络恢复
+         */
+        void recordFailure();
+
+        /**
+         * 上传成功：若此前处于失败期，把积压分段的下一次重试提前到现在，尽快排空积压；
+         * 各分段保留失败次数，非网络原因持续失败的分段再次失败后仍按指数退避
+         */
+        void recordSuccess();
+
+        /**
+         * 分段上传失败：按指数退避安排下一次重试
+         */
+        void retryLater(const Segment &segment);
+
+        /**
+         * 积压的分段数
+         */
+        size_t size() const;
+
+        /**
+         * 积压的总字节数
+         */
+        uint64_t bytes() const;
+
+    private:
+        struct Entry
+        {
+            Segment segment;
+            int attempts = 0;                                  // 已失败的次数
+            std::chrono::steady_clock::time_point nextAttempt; // 下一次允许重试的时刻
+            bool inFlight = false;                             // 是否正在上传
+        };
+
+        /**
+         * 重放journal并扫描目录，恢复上次运行遗留的分段，然后压缩journal
+         */
+        void recover();
+
+        /**
+         * 以当前积压重写journal（写临时文件后rename，保证原子性）；启动时以及运行期间del记录累计过多时执行
+         */
+        void compactJournal();
+
+        /**
+         * 追加一行journal记录并fsync
+         */
+        void appendJournal(const std::string &line);
+
+        /**
+         * 超出字节预算时淘汰最旧的分段（调用方持有锁）
+         */
+        void enforceBudget();
+
+        /**
+         * 删除分段文件、断点文件以及journal记录（调用方持有锁）
+         */
+        void removeEntry(std::list<Entry>::iterator it);
+
+        /**
+         * 计算第attempts次失败后的退避时长（带随机抖动）
+         */
+        std::chrono::milliseconds backoff(int attempts);
+
+        // 配置参数
+        AppConfig config;
+
+        mutable std::mutex mutex;
+        std::list<Entry> entries;   // 按入队顺序排列，最旧的在前
+        uint64_t totalBytes = 0;    // 积压的总字节数
+        int journalFd = -1;         // journal文件描述符（O_APPEND）
+        size_t journalDeletes = 0;  // 上次压缩后journal中的del记录数，超过阈值时在运行期间压缩
+        bool failing = false;       // 是否处于失败期（新分段上传失败后尚未有上传成功）
+        std::mt19937 rng;           // 退避抖动的随机数
+    };
+} // namespace VideoStreamer
@@ -1,153 +1,303 @@
 #include "video_encoder.hpp"
+#include "pixel_convert.hpp"
+#include <fcntl.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <sys/wait.h>
-#include <sys/stat.h>
+#include <sys/resource.h>
+#include <chrono>
+#include <csignal>
 #include <cstring>
 #include <fstream>
+#include <iostream>
 
 namespace VideoStreamer
 {
-    VideoEncoder::VideoEncoder(const AppConfig &cfg) : config(cfg) {}
-
-    void VideoEncoder::encode(const std::vector<std::string> &inputFiles, const std::string &outputFile)
+    namespace
     {
-        std::string dir = config.tempDir;
-        if (!dir.empty() && dir.back() != '/')
+        // 当前线程消耗的CPU时间（毫秒）
+        double threadCpuMs()
         {
-            dir += '/';
+            struct rusage usage;
+            getrusage(RUSAGE_THREAD, &usage);
+            return usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0 +
+                   usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0;
         }
 
-        // // 构造FFmpeg所需的输入文件列表字符串
-        // std::string inputList;
-        // for (const auto &f : inputFiles)
-        //     inputList += "file '" + f + "'\n"; // 为每个输入文件生成合适的FFmpeg格式
-
-        // 检查 tempDir 是否存在，不存在则创建
-        if (mkdir(config.tempDir.c_str(), 0755) != 0)
+        // 写入整个缓冲，成功返回true；失败时errno为write的错误码
+        bool writeAll(int fd, const uint8_t *data, size_t size)
         {
-            if (errno != EEXIST)
-            { // 如果目录创建失败且不是因为已经存在的原因
-                std::cerr << "Failed to create directory: " << strerror(errno) << std::endl;
+            while (size > 0)
+            {
+                ssize_t written = write(fd, data, size);
+                if (written < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    return false;
+                }
+                data += written;
+                size -= written;
             }
+            return true;
         }
-        // 将输入列表写入临时文件
-        const std::string listFile = dir + "ffmpeg_list.txt";
+    } // namespace
+
+    VideoEncoder::VideoEncoder(const AppConfig &cfg) : config(cfg), renditions(resolveRenditions(cfg)), bitRate(cfg.bitRate)
+    {
+        if (config.encoderBackend == EncoderBackend::Libav)
         {
-            std::ofstream f(listFile);
-            for (const auto &file : inputFiles)
+            pictures.reset(new PictureLadder());
+            for (const auto &rendition : renditions)
             {
-                f << "file '" << file << "'\n"; // 正确格式
+                EncoderOptions opts;
+                opts.bitRate = rendition.bitRate;
+                opts.width = rendition.width;
+                opts.height = rendition.height;
+                libav.emplace_back(new LibavEncoder(config, opts));
             }
         }
+    }
 
-        // 创建子进程进行FFmpeg编码操作
-        pid_t pid = fork(); // 创建子进程
-        if (pid == 0)       // 子进程执行编码操作
+    void VideoEncoder::checkOutputs(size_t count) const
+    {
+        if (count != renditions.size())
+        {
+            throw std::runtime_error("[VideoEncoder] 输出个数(" + std::to_string(count) + ")与编码阶梯的档位数(" +
+                                     std::to_string(renditions.size()) + ")不一致");
+        }
+    }
+
+    void VideoEncoder::encode(const std::vector<FramePtr> &frames, const std::vector<std::string> &outputFiles)
+    {
+        checkOutputs(outputFiles.size());
+        auto begin = std::chrono::steady_clock::now();
+        double cpuMs = 0.0;
+
+        if (!libav.empty())
+        {
+            std::vector<std::ofstream> files;
+            std::vector<LibavEncoder::PacketHandler> handlers;
+            files.reserve(outputFiles.size()); // 回调持有文件流的引用，不能重新分配
+            for (const auto &outputFile : outputFiles)
+            {
+                files.emplace_back(outputFile, std::ios::binary);
+                if (!files.back().is_open())
+                {
+                    throw std::runtime_error("[VideoEncoder] 输出文件打开失败: " + outputFile);
+                }
+                std::ofstream &out = files.back();
+                handlers.push_back([&out](AVPacket *pkt)
+                                   { out.write(reinterpret_cast<const char *>(pkt->data), pkt->size); });
+            }
+
+            double cpuBegin = threadCpuMs();
+            encodeLadder(frames, handlers);
+            cpuMs = threadCpuMs() - cpuBegin;
+        }
+        else
         {
-            // 使用execlp调用FFmpeg进行视频合并和编码
-            execlp(config.ffmpegPath.c_str(), "ffmpeg",
-                   "-y",                    // 覆盖输出文件
-                   "-f", "concat",          // 输入格式为concat（连接多个视频）
-                   "-safe", "0",            // 允许不安全的文件路径
-                   "-i", listFile.c_str(),  // 输入文件列表
-                   "-c:v", "libx264",       // 使用H.264编码器
-                   "-b:v", "3M",            // 设置视频比特率为3Mbps
-                   "-g", "15",              // 设置关键帧间隔为15
-                   "-profile:v", "high422", // 设置H.264的profile为high422
-                   "-f", "h264",            // 设置输出格式为h264
-                   outputFile.c_str(),      // 输出文件路径
-                   nullptr);                // 参数结尾
+            encodeWithCli(frames, outputFiles, cpuMs);
+        }
+        logBatch(frames.size(), begin, cpuMs);
+    }
 
-            exit(EXIT_FAILURE); // 如果execlp失败，则退出子进程
+    void VideoEncoder::encode(const std::vector<FramePtr> &frames, std::vector<std::vector<uint8_t>> &outputs)
+    {
+        if (libav.empty())
+        {
+            throw std::runtime_error("[VideoEncoder] ffmpeg命令行后端不支持编码到内存");
         }
-        int status;
-        waitpid(pid, nullptr, 0);               // 父进程等待子进程执行完毕
-        if (std::remove(listFile.c_str()) != 0) // 删除临时文件
+        checkOutputs(outputs.size());
+
+        std::vector<LibavEncoder::PacketHandler> handlers;
+        for (auto &output : outputs)
         {
-            std::cerr << "[VideoEncoder] 无法删除文件 '" << listFile << "': " << strerror(errno) << std::endl;
+            handlers.push_back([&output](AVPacket *pkt)
+                               { output.insert(output.end(), pkt->data, pkt->data + pkt->size); });
         }
 
-        // 检查编码是否成功
-        if (WIFEXITED(status))
+        auto begin = std::chrono::steady_clock::now();
+        double cpuBegin = threadCpuMs();
+        encodeLadder(frames, handlers);
+        logBatch(frames.size(), begin, threadCpuMs() - cpuBegin);
+    }
+
+    void VideoEncoder::encodeLadder(const std::vector<FramePtr> &frames,
+                                    const std::vector<LibavEncoder::PacketHandler> &handlers)
+    {
+        bool firstFrame = true;
+        for (const auto &frame : frames)
         {
-            if (WEXITSTATUS(status) != 0)
+            if (!pictures->load(*frame))
+                continue;
+
+            // 每个批次的第一帧在所有档位都强制为关键帧
+            for (size_t i = 0; i < libav.size(); ++i)
             {
-                throw std::runtime_error("FFmpeg编码失败");
+                if (libav[i]->preparePicture(*pictures))
+                    libav[i]->encodePrepared(nextPts, firstFrame, handlers[i]);
             }
+            ++nextPts;
+            firstFrame = false;
         }
 
-        // 执行保留策略
-        switch (config.deletePolicy)
+        if (firstFrame)
         {
-        case DeletePolicy::KeepAll:
+            throw std::runtime_error("[VideoEncoder] 批次中没有可编码的帧");
+        }
+    }
+
+    void VideoEncoder::setBitRate(int64_t rate)
+    {
+        bitRate = rate;
+        for (size_t i = 0; i < libav.size(); ++i)
         {
+            libav[i]->setBitRate(renditionBitRate(renditions[i], rate, config.bitRate));
+        }
+    }
+
+    void VideoEncoder::logBatch(size_t frameCount, std::chrono::steady_clock::time_point begin, double cpuMs) const
+    {
+        std::chrono::duration<double, std::milli> wallMs = std::chrono::steady_clock::now() - begin;
+        std::cout << "[VideoEncoder] " << (libav.empty() ? "ffmpeg-cli" : "libav") << " 批次 " << frameCount
+                  << " 帧 x " << renditions.size() << " 档位，耗时 " << wallMs.count() << " ms，CPU " << cpuMs << " ms" << std::endl;
+    }
 
-            break;
+    void VideoEncoder::encodeWithCli(const std::vector<FramePtr> &frames, const std::vector<std::string> &outputFiles,
+                                     double &cpuMs)
+    {
+        // MJPEG帧首尾相接即为mjpeg流；未压缩帧按rawvideo输入，转为4:2:0编码
+        const Frame &first = *frames.front();
+        const bool raw = isRawFormat(first.format);
+        std::vector<std::string> argv = {"ffmpeg", "-y"}; // 覆盖输出文件
+        if (raw)
+        {
+            argv.insert(argv.end(), {"-f", "rawvideo",
+                                     "-pix_fmt", first.format == OB_FORMAT_YUYV ? "yuyv422" : "nv12",
+                                     "-video_size", std::to_string(first.width) + "x" + std::to_string(first.height)});
+        }
+        else
+        {
+            argv.insert(argv.end(), {"-f", "mjpeg"}); // 输入格式为MJPEG流（JPEG帧首尾相接）
         }
+        argv.insert(argv.end(), {"-framerate", std::to_string(config.targetFPS), // 输入帧率
+                                 "-i", "pipe:0"});                               // 从标准输入读取
 
-        case DeletePolicy::DeleteOnSuccess:
+        // 编码阶梯：输入只解码一次，split后各档位分别缩放（只有一个不缩放的档位时不需要滤镜）
+        const bool filtered = renditions.size() > 1 || renditions.front().width > 0 || renditions.front().height > 0;
+        if (filtered)
         {
-            // 删除当前批次文件
-            for (const auto &file : inputFiles)
+            std::string graph = "[0:v]split=" + std::to_string(renditions.size());
+            for (size_t i = 0; i < renditions.size(); ++i)
+                graph += "[s" + std::to_string(i) + "]";
+            for (size_t i = 0; i < renditions.size(); ++i)
             {
-                const std::string frameFile = dir + file;
-                if (std::remove(frameFile.c_str()) != 0)
-                {
-                    std::cerr << "[VideoEncoder] 无法删除文件 '" << frameFile << "': " << strerror(errno) << std::endl;
-                }
-                else
-                {
-                    std::cout << "[VideoEncoder] 编码成功，删除原始帧文件" << std::endl;
-                }
+                const Rendition &rendition = renditions[i];
+                // 只设置一边时另一边按比例取偶数（-2），都不设置时保持输入尺寸
+                const bool keep = rendition.width <= 0 && rendition.height <= 0;
+                std::string width = keep ? "iw" : rendition.width > 0 ? std::to_string(rendition.width) : "-2";
+                std::string height = keep ? "ih" : rendition.height > 0 ? std::to_string(rendition.height) : "-2";
+                graph += ";[s" + std::to_string(i) + "]scale=" + width + ":" + height + "[v" + std::to_string(i) + "]";
             }
-            break;
+            argv.insert(argv.end(), {"-filter_complex", graph});
+        }
+
+        for (size_t i = 0; i < renditions.size(); ++i)
+        {
+            if (filtered)
+                argv.insert(argv.end(), {"-map", "[v" + std::to_string(i) + "]"});
+            argv.insert(argv.end(), {"-c:v", "libx264", // 使用H.264编码器
+                                     "-b:v", std::to_string(renditionBitRate(renditions[i], bitRate, config.bitRate)), // 设置视频比特率（自适应码率调整）
+                                     "-g", "15"});      // 设置关键帧间隔为15
+            if (raw)
+                argv.insert(argv.end(), {"-pix_fmt", "yuv420p", "-profile:v", "high"});
+            else
+                argv.insert(argv.end(), {"-profile:v", "high422"}); // 设置H.264的profile为high422
+            argv.insert(argv.end(), {"-f", "h264", outputFiles[i]}); // 输出格式为h264
+        }
+
+        std::vector<const char *> args;
+        for (const auto &arg : argv)
+            args.push_back(arg.c_str());
+        args.push_back(nullptr);
+
+        int pipeFds[2];
+        // O_CLOEXEC：多个编码线程同时fork时，子进程不能继承其他批次管道的写端，否则对方的ffmpeg读不到EOF而一直等待
+        // （dup2到标准输入后不带该标志，本批次的ffmpeg照常读取）
+        if (pipe2(pipeFds, O_CLOEXEC) != 0)
+        {
+            throw std::runtime_error("FFmpeg管道创建失败: " + std::string(strerror(errno)));
+        }
+
+        // 创建子进程进行FFmpeg编码操作
+        pid_t pid = fork(); // 创建子进程
+        if (pid == 0)       // 子进程执行编码操作
+        {
+            dup2(pipeFds[0], STDIN_FILENO); // 从管道读取帧数据
+            close(pipeFds[0]);
+            close(pipeFds[1]);
+
+            // 使用execvp调用FFmpeg进行视频编码（参数在fork之前构造好）
+            execvp(config.ffmpegPath.c_str(), const_cast<char *const *>(args.data()));
+
+            _exit(127); // exec失败时直接退出子进程（多线程进程fork出的子进程不能运行atexit或刷新stdio缓冲）
+        }
+        close(pipeFds[0]);
+        if (pid < 0)
+        {
+            close(pipeFds[1]);
+            throw std::runtime_error("FFmpeg进程创建失败: " + std::string(strerror(errno)));
         }
 
-        case DeletePolicy::DeleteWhenExceed:
+        // 将帧数据写入子进程的标准输入
+        // 子进程提前退出时写管道会产生SIGPIPE：只在本线程写管道期间屏蔽该信号，write改为返回EPIPE，
+        // 之后取走本次产生的待处理信号再恢复屏蔽字，不改变整个进程的信号处理方式
+        sigset_t pipeMask, oldMask, pending;
+        sigemptyset(&pipeMask);
+        sigaddset(&pipeMask, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipeMask, &oldMask);
+        sigpending(&pending);
+        const bool alreadyPending = sigismember(&pending, SIGPIPE) == 1;
+
+        int writeError = 0;
+        for (const auto &frame : frames)
         {
-            // 将当前批次加入跟踪队列
-            for (const auto &file : inputFiles)
+            if (!writeAll(pipeFds[1], frame->data(), frame->dataSize()))
             {
-                FileInfo info;
-                if (getFileInfo(file, info))
-                {
-                    fileQueue.push_back(info);
-                    totalSize += info.size;
-                }
+                writeError = errno;
+                break; // 子进程已退出或管道出错，其余帧不再写入，退出状态在下面检查
             }
+        }
+        close(pipeFds[1]);
 
-            // 计算内存阈值（字节）
-            const size_t maxBytes = config.maxMemoryMB * 1024 * 1024;
-
-            // 删除最早文件直到满足内存限制
-            while (!fileQueue.empty() && totalSize > maxBytes)
+        if (writeError == EPIPE && !alreadyPending)
+        {
+            struct timespec noWait = {0, 0};
+            while (sigtimedwait(&pipeMask, nullptr, &noWait) < 0 && errno == EINTR)
             {
-                const auto &oldest = fileQueue.front();
-                if (std::remove(oldest.path.c_str()) == 0)
-                {
-                    totalSize -= oldest.size;
-                    fileQueue.pop_front();
-                    std::cout << "[VideoEncoder] 删除旧文件: " << oldest.path << "\n";
-                }
-                else
-                {
-                    break; // 防止无限循环
-                }
             }
-            break;
         }
+        pthread_sigmask(SIG_SETMASK, &oldMask, nullptr);
+
+        int status = 0;
+        struct rusage usage;
+        pid_t waited;
+        // 父进程等待子进程执行完毕，并获取其资源占用（被信号中断时重新等待）
+        while ((waited = wait4(pid, &status, 0, &usage)) < 0 && errno == EINTR)
+        {
         }
-    }
+        if (waited != pid)
+        {
+            throw std::runtime_error("FFmpeg进程等待失败: " + std::string(strerror(errno)));
+        }
+        cpuMs = usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0 +
+                usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0;
 
-    bool VideoEncoder::getFileInfo(const std::string &path, FileInfo &info)
-    {
-        struct stat statBuf;
-        if (stat(path.c_str(), &statBuf) != 0)
-            return false;
-
-        info.path = path;
-        info.size = statBuf.st_size;
-        info.createdTime = std::chrono::system_clock::from_time_t(statBuf.st_ctime);
-        return true;
+        // 检查编码是否成功
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            throw std::runtime_error("FFmpeg编码失败");
+        }
     }
-} // namespace VideoStreamer
\ No newline at end of file
+} // namespace VideoStreamer
@@ -1,19 +1,20 @@
 #pragma once
 #include "config.hpp"
+#include "frame.hpp"
+#include "libav_encoder.hpp"
+#include "picture_ladder.hpp"
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <vector>
 #include <string>
 
 namespace VideoStreamer
 {
-    // 文件信息结构体
-    struct FileInfo {
-        std::string path;
-        size_t size;
-        std::chrono::system_clock::time_point createdTime;
-    };
-    
     /**
      * VideoEncoder 类用于视频编码
+     * 按编码阶梯（AppConfig::renditions）一次输出多个档位：Libav后端每帧只解码一次，各档位的编码器共享缩放后的画面；
+     * ffmpeg命令行后端在同一个进程内split后分别缩放编码
      */
     class VideoEncoder
     {
@@ -21,20 +22,61 @@ namespace VideoStreamer
         explicit VideoEncoder(const AppConfig &cfg);
 
         /**
-         * 编码函数，将多个输入文件编码成一个输出文件
+         * 编码函数，将一批内存中的帧编码成输出文件，outputFiles按档位顺序各一个
+         */
+        void encode(const std::vector<FramePtr> &frames,
+                    const std::vector<std::string> &outputFiles);
+
+        /**
+         * 将一批帧编码到内存缓冲，outputs按档位顺序各一个（仅Libav后端支持）
+         */
+        void encode(const std::vector<FramePtr> &frames,
+                    std::vector<std::vector<uint8_t>> &outputs);
+
+        /**
+         * 是否支持直接编码到内存
+         */
+        bool supportsMemoryOutput() const { return !libav.empty(); }
+
+        /**
+         * 编码阶梯的档位（renditions为空时只有一个采集分辨率的档位）
+         */
+        const std::vector<Rendition> &ladder() const { return renditions; }
+
+        /**
+         * 调整编码码率（对应配置的bitRate），各档位按比例调整，下一批次起生效
          */
-        void encode(const std::vector<std::string> &inputFiles,
-                    const std::string &outputFile);
+        void setBitRate(int64_t bitRate);
 
     private:
         /**
-         * 获取文件信息
+         * 调用ffmpeg命令行编码（帧数据通过管道写入stdin），cpuMs返回子进程消耗的CPU时间
+         */
+        void encodeWithCli(const std::vector<FramePtr> &frames,
+                           const std::vector<std::string> &outputFiles, double &cpuMs);
+
+        /**
+         * Libav后端编码一批帧：每帧解码一次，依次送入各档位的编码器，handlers按档位顺序接收数据包
+         */
+        void encodeLadder(const std::vector<FramePtr> &frames,
+                          const std::vector<LibavEncoder::PacketHandler> &handlers);
+
+        /**
+         * 检查输出个数与档位数一致
+         */
+        void checkOutputs(size_t count) const;
+
+        /**
+         * 输出单批次的耗时统计
          */
-        bool getFileInfo(const std::string& path, FileInfo& info);
+        void logBatch(size_t frameCount, std::chrono::steady_clock::time_point begin, double cpuMs) const;
 
         // 配置对象，存储编码所需的配置信息
         AppConfig config;
-        std::deque<FileInfo> fileQueue;  // 文件跟踪队列
-        size_t totalSize = 0;            // 当前总文件大小
+        std::vector<Rendition> renditions;    // 编码阶梯的档位
+        std::unique_ptr<PictureLadder> pictures; // 各档位共享的解码/缩放（encoderBackend为Libav时使用）
+        std::vector<std::unique_ptr<LibavEncoder>> libav; // 各档位的进程内编码器（encoderBackend为Libav时使用）
+        int64_t bitRate;                      // 当前码率（bps，对应配置的bitRate）
+        int64_t nextPts = 0;                  // 下一帧的显示时间戳（各档位相同）
     };
-} // namespace VideoStreamer
\ No newline at end of file
+} // namespace VideoStreamer